@@ -0,0 +1,278 @@
+// indrascheme-aot: translates a library of defined functions to C++ source.
+//
+// Usage: indrascheme-aot <library.scm> <output.cpp> [<register function>]
+//
+// Every function whose body the int code compiler covers (see specCompile() in
+// indrascheme.h) is emitted as native C++ working on INT arguments. The generated
+// register function loads the library source into an interpreter instance and adds
+// the native functions with add_native(), so calls with other arguments, and cases
+// the native code doesn't cover, run the interpreted definitions as before.
+#include "indrascheme.h"
+
+#include <iostream>  // cout, cerr, endl
+#include <fstream>   // ifstream, ofstream
+#include <sstream>   // stringstream
+#include <map>
+
+using insch::IndraScheme;
+using insch::ISAtom;
+using insch::ISFrame;
+using insch::ISFunc;
+using insch::ISIntCode;
+using insch::ISIntOp;
+using insch::ISScopes;
+using std::endl;
+using std::string;
+
+string cName(const string &name) {
+    string cn = "aot_";
+    const char *hex = "0123456789abcdef";
+    for (unsigned char c : name) {
+        if (isalnum(c)) {
+            cn += c;
+        } else {
+            cn += '_';
+            cn += hex[c >> 4];
+            cn += hex[c & 15];
+        }
+    }
+    return cn;
+}
+
+string cString(const string &s) {
+    string cs = "\"";
+    for (char c : s) {
+        switch (c) {
+        case '\\':
+            cs += "\\\\";
+            break;
+        case '"':
+            cs += "\\\"";
+            break;
+        case '\n':
+            cs += "\\n\"\n    \"";
+            break;
+        default:
+            cs += c;
+            break;
+        }
+    }
+    return cs + "\"";
+}
+
+// The functions native code of fn calls directly, its own excepted.
+void nativeCallees(const ISFunc &fn, vector<const ISFunc *> &callees) {
+    for (const ISIntOp &op : fn.pIntCode->ops) {
+        if (op.op != ISIntOp::CALL || op.pFn == &fn || std::find(callees.begin(), callees.end(), op.pFn) != callees.end()) continue;
+        callees.push_back(op.pFn);
+        nativeCallees(*op.pFn, callees);
+    }
+}
+
+bool emitFunction(std::ostream &out, const string &name, const ISFunc &fn, const std::map<const ISFunc *, string> &names) {
+    static const char *mathOps[] = {"+", "-", "*", "/", "%"};
+    static const char *cmpOps[] = {"==", "!=", ">=", "<=", "<", ">", "&&", "||"};
+    const ISIntCode &ic = *fn.pIntCode;
+    vector<int> depth;
+    vector<bool> target;
+    int maxDepth;
+    if (!IndraScheme::specStackDepths(ic, depth, target, maxDepth)) return false;
+    std::stringstream body;
+    for (size_t pc = 0; pc < ic.ops.size(); pc++) {
+        const ISIntOp &op = ic.ops[pc];
+        int d = depth[pc];
+        if (target[pc]) body << "L" << pc << ":" << endl;
+        if (d < 0) continue;
+        string s = "s" + std::to_string(d), s1 = "s" + std::to_string(d - 1), s2 = "s" + std::to_string(d - 2);
+        body << "    ";
+        switch (op.op) {
+        case ISIntOp::CONST:
+            body << s << " = " << op.a << ";";
+            break;
+        case ISIntOp::LOAD:
+            body << s << " = r[" << op.a << "];";
+            break;
+        case ISIntOp::STORE:
+            body << "r[" << op.a << "] = " << s1 << ";";
+            break;
+        case ISIntOp::POP:
+            body << ";";
+            break;
+        case ISIntOp::DIV:
+        case ISIntOp::MOD:
+            body << "if (!" << s1 << ") return false;" << endl
+                 << "    ";
+            // fallthrough
+        case ISIntOp::ADD:
+        case ISIntOp::SUB:
+        case ISIntOp::MUL:
+            body << s2 << " " << mathOps[op.op - ISIntOp::ADD] << "= " << s1 << ";";
+            break;
+        case ISIntOp::EQ:
+        case ISIntOp::NE:
+        case ISIntOp::GE:
+        case ISIntOp::LE:
+        case ISIntOp::LT:
+        case ISIntOp::GT:
+        case ISIntOp::AND:
+        case ISIntOp::OR:
+            body << s2 << " = " << s2 << " " << cmpOps[op.op - ISIntOp::EQ] << " " << s1 << ";";
+            break;
+        case ISIntOp::JUMP:
+            body << "goto L" << op.a << ";";
+            break;
+        case ISIntOp::JUMP_FALSE:
+            body << "if (!" << s1 << ") goto L" << op.a << ";";
+            break;
+        case ISIntOp::CALL: {
+            auto it = names.find(op.pFn);
+            if (it == names.end()) return false;
+            body << "if (!" << it->second << "(&r[" << op.a << "], " << s << ")) return false;";
+        } break;
+        case ISIntOp::TAIL:
+            for (int i = 0; i < op.b; i++)
+                body << "r[" << i << "] = r[" << op.a + i << "];" << endl
+                     << "    ";
+            body << "goto L0;";
+            break;
+        case ISIntOp::DEOPT:
+            body << "return false;";
+            break;
+        case ISIntOp::RET:
+            body << "res = " << s1 << ";" << endl
+                 << "    return true;";
+            break;
+        }
+        body << endl;
+    }
+    out << "bool " << names.at(&fn) << "(const int *args, int &res) {  // " << name << endl;
+    out << "    int r[" << std::max(ic.nRegs, 1) << "];" << endl;
+    for (int i = 0; i < maxDepth; i++)
+        out << "    int s" << i << ";" << endl;
+    for (int i = 0; i < fn.nParams; i++)
+        out << "    r[" << i << "] = args[" << i << "];" << endl;
+    out << body.str() << "}" << endl
+        << endl;
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <library.scm> <output.cpp> [<register function>]" << endl;
+        return 1;
+    }
+    string libName = argv[1];
+    std::ifstream in(libName);
+    if (!in) {
+        std::cerr << "Can't read " << libName << endl;
+        return 1;
+    }
+    std::stringstream src;
+    src << in.rdbuf();
+    string source = src.str();
+    string stem = libName.substr(libName.find_last_of('/') + 1);
+    stem = stem.substr(0, stem.find('.'));
+    string regName = argc > 3 ? argv[3] : "register_" + cName(stem).substr(4);
+
+    IndraScheme ins;
+    ISScopes lsyms;
+    lsyms.push_back(ISFrame{});
+    ISAtom *pRes = ins.load_string(source, lsyms);
+    bool bErr = pRes && pRes->t == ISAtom::TokType::ERROR;
+    if (bErr) std::cerr << libName << ": " << pRes->vals.str() << endl;
+    ins.deleteList(pRes, "aot load");
+    if (bErr) return 1;
+
+    // Functions in definition order: a callee must be compiled before its callers.
+    vector<string> defs;
+    int lvl = 0;
+    string parsed = source;
+    ISAtom *pisa = ins.parse(parsed, nullptr, lvl);
+    for (const ISAtom *p = pisa; p; p = p->pNext) {
+        if (p->t != ISAtom::TokType::LIST || !p->pChild || p->pChild->vals != "define") continue;
+        const ISAtom *pSig = p->pChild->pNext;
+        if (pSig && pSig->t == ISAtom::TokType::LIST && pSig->pChild) defs.push_back(pSig->pChild->vals);
+    }
+    ins.deleteList(pisa, "aot parse");
+
+    // Result types are static: the body type checks as INT or as BOOLEAN, or not at all.
+    std::map<const ISFunc *, string> names, schemeNames;
+    vector<string> natives;
+    for (const string &name : defs) {
+        int id = insch::ISStr::symbolId(name);
+        if (!ins.funcInfo.contains(id) || names.count(ins.funcInfo[id].get())) continue;
+        const ISFunc &fn = *ins.funcInfo[id];
+        for (int t : {ISAtom::TokType::INT, ISAtom::TokType::BOOLEAN}) {
+            fn.resultTypes = 1u << t;
+            fn.nSpecAttempts = 0;
+            if (fn.pIntCode || ins.specCompile(fn)) break;
+        }
+        if (!fn.pIntCode) {
+            fn.resultTypes = 0;
+            continue;
+        }
+        names[&fn] = cName(name);
+        schemeNames[&fn] = name;
+        natives.push_back(name);
+    }
+
+    std::stringstream code;
+    for (const string &name : natives) {
+        const ISFunc &fn = *ins.funcInfo[insch::ISStr::symbolId(name)];
+        if (!emitFunction(code, name, fn, names)) {
+            std::cerr << "Internal error: inconsistent int code of " << name << endl;
+            return 1;
+        }
+    }
+
+    std::ofstream out(argv[2]);
+    out << "// Generated by indrascheme-aot from " << libName << ", do not edit." << endl
+        << "#include \"indrascheme.h\"" << endl
+        << endl
+        << "namespace {" << endl
+        << endl
+        << "const char *source =" << endl
+        << "    " << cString(source) << ";" << endl
+        << endl;
+    for (auto &fn : names)
+        out << "bool " << fn.second << "(const int *args, int &res);" << endl;
+    out << endl
+        << code.str()
+        << "}  // namespace" << endl
+        << endl
+        << "// Loads the library into is and registers its native functions, false if loading failed." << endl
+        << "bool " << regName << "(insch::IndraScheme &is) {" << endl
+        << "    insch::ISScopes local_symbols;" << endl
+        << "    local_symbols.push_back(insch::ISFrame{});" << endl
+        << "    insch::ISAtom *pRes = is.load_string(source, local_symbols);" << endl
+        << "    bool bOk = !pRes || pRes->t != insch::ISAtom::TokType::ERROR;" << endl
+        << "    is.deleteList(pRes, \"aot load\");" << endl
+        << "    is.pop_local_symbols(local_symbols);" << endl
+        << "    if (!bOk) return false;" << endl;
+    for (auto &fn : natives) {
+        const ISFunc &f = *ins.funcInfo[insch::ISStr::symbolId(fn)];
+        out << "    is.add_native(" << cString(fn) << ", " << names[&f] << ", " << (f.pIntCode->bBoolResult ? "true" : "false");
+        vector<const ISFunc *> callees;
+        nativeCallees(f, callees);
+        if (callees.size()) {
+            out << ", {";
+            for (size_t i = 0; i < callees.size(); i++)
+                out << (i ? ", " : "") << cString(schemeNames[callees[i]]);
+            out << "}";
+        }
+        out << ");" << endl;
+    }
+    out << "    return true;" << endl
+        << "}" << endl;
+    if (!out) {
+        std::cerr << "Can't write " << argv[2] << endl;
+        return 1;
+    }
+    std::cout << argv[2] << ": " << natives.size() << " of " << defs.size() << " functions native";
+    for (auto &fn : natives)
+        std::cout << " " << fn;
+    std::cout << endl;
+    ins.pop_local_symbols(lsyms);
+    ins.deleteAllDefines();
+    return 0;
+}
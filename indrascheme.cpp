@@ -11,6 +11,8 @@
 
 using insch::IndraScheme;
 using insch::ISAtom;
+using insch::ISFrame;
+using insch::ISScopes;
 using std::endl;
 using std::string;
 
@@ -142,11 +144,55 @@ string charReader(string prompt, bool *pQuit, string term) {
     return inp;
 }
 
+// Repl-only inbuilts for scripts like samples/selftest.scm that exercise the embedding
+// settings: (gctracing #t) collects after every top-level expression from now on,
+// (heapbudget <bytes> <expr>) evaluates expr with a heap budget of bytes more than in use.
+void addReplInbuilts(IndraScheme &ins) {
+    ins.add_inbuilt("gctracing", [&ins](const ISAtom *pisa, ISScopes &local_symbols) {
+        ISAtom *pArgs = ins.chainEval(pisa, local_symbols, true);
+        ISAtom *pRes = ins.gca();
+        if (ins.getListLen(pArgs) != 1 || pArgs->t != ISAtom::TokType::BOOLEAN) {
+            pRes->t = ISAtom::TokType::ERROR;
+            pRes->vals = "'gctracing' requires one boolean operand";
+        } else {
+            ins.gcTracing = pArgs->val != 0;
+            ins.gcThreshold = 0;
+            pRes->t = ISAtom::TokType::BOOLEAN;
+            pRes->val = pArgs->val;
+        }
+        ins.deleteList(pArgs, "gctracing");
+        return pRes;
+    });
+    ins.add_inbuilt("heapbudget", [&ins](const ISAtom *pisa, ISScopes &local_symbols) {
+        if (ins.getListLen(pisa) != 2) {
+            ISAtom *pRes = ins.gca();
+            pRes->t = ISAtom::TokType::ERROR;
+            pRes->vals = "'heapbudget' requires two operands: <bytes> <expr>";
+            return pRes;
+        }
+        ISAtom *pBytes = ins.evalAtom(pisa, local_symbols);
+        if (pBytes->t != ISAtom::TokType::INT || pBytes->val < 0) {
+            ins.deleteList(pBytes, "heapbudget 1");
+            ISAtom *pRes = ins.gca();
+            pRes->t = ISAtom::TokType::ERROR;
+            pRes->vals = "'heapbudget' requires a non-negative integer number of bytes";
+            return pRes;
+        }
+        size_t nBudget = ins.gcpool.byteBudget;
+        ins.set_heap_budget(ins.heap_bytes() + pBytes->val);
+        ins.deleteList(pBytes, "heapbudget 2");
+        ISAtom *pRes = ins.evalAtom(pisa->pNext, local_symbols);
+        ins.set_heap_budget(nBudget);
+        return pRes;
+    });
+}
+
 void repl(std::string &prompt, std::string &prompt2, bool bUnicode, string term, vector<string> file_names) {
     std::string cmd, inp;
     bool fst;
     string ans;
     IndraScheme ins;
+    addReplInbuilts(ins);
     ISAtom::DecorType decor;
 
     if (bUnicode)
@@ -154,8 +200,8 @@ void repl(std::string &prompt, std::string &prompt2, bool bUnicode, string term,
     else
         decor = ISAtom::DecorType::ASCII;
 
-    vector<map<string, ISAtom *>> lsyms;
-    lsyms.push_back(map<string, ISAtom *>{});
+    ISScopes lsyms;
+    lsyms.push_back(ISFrame{});
     ISAtom *pisa, *pisa_res;
 
     if (file_names.size() > 0) {
@@ -215,17 +261,16 @@ void repl(std::string &prompt, std::string &prompt2, bool bUnicode, string term,
         ins.deleteList(pisa, "repl 2");
         cout << ", ss3: " << ins.gc_size() << endl;
 
-        bool showDebris = true;
+        bool showDebris = IndraScheme::memDbg;
         if (showDebris) {
-            for (auto p : ins.gctr) {
-                cout << "Debris: " << p.first << " " << ins.tokTypeNames[p.first->t] << " ";
-                ins.print(p.first, lsyms, decor, true);
+            for (auto p : ins.gc_registered()) {
+                cout << "Debris: " << p << " " << ins.tokTypeNames[p->t] << " ";
+                ins.print(p, lsyms, decor, true);
                 cout << endl;
             }
         }
 
-        // ins.gctr.clear();  // XXX! corpses alot!
-        // ins.gc_clear(nullptr, lsyms);
+        if (ins.gcTracing) ins.gc_collect(lsyms);
     }
 }
 
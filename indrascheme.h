@@ -3,7 +3,21 @@
 #include <vector>
 #include <algorithm>
 #include <map>
+#include <deque>
+#include <unordered_map>
 #include <functional>
+#include <new>
+#include <cstdint>
+#include <cstdlib>
+#include <climits>
+#include <memory>
+#include <mutex>
+
+// Native code generation for hot int code, see IndraScheme::jitCompile()
+#if defined(__x86_64__) && defined(__linux__)
+#define INSCH_JIT
+#include <sys/mman.h>
+#endif
 
 using std::cout;
 using std::endl;
@@ -13,9 +27,336 @@ using std::vector;
 
 namespace insch {
 
+// Global symbol table: every symbol name is interned once and gets a small
+// integer id, namespaces (ISSymMap) are indexed by that id. It is shared by all
+// instances and threads, hence the mutex. Entries are never removed, so only
+// names from parsed code and the host are interned, not runtime string data.
+struct ISSymbol {
+  string name;
+  int id;
+};
+
+class ISSymbolTable {
+  std::deque<ISSymbol> syms;  // deque: entries never move
+  std::unordered_map<string, int> ids;
+  mutable std::mutex mtx;
+
+  public:
+  static ISSymbolTable &global() {
+    static ISSymbolTable table;
+    return table;
+  }
+  const ISSymbol *intern(const string &name) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto pos = ids.find(name);
+    if (pos != ids.end()) return &syms[pos->second];
+    syms.push_back({name, (int)syms.size()});
+    ids[name] = syms.back().id;
+    return &syms.back();
+  }
+  int find(const string &name) const {  // -1: not interned
+    std::lock_guard<std::mutex> lock(mtx);
+    auto pos = ids.find(name);
+    return pos == ids.end() ? -1 : pos->second;
+  }
+  const string &name(int id) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return syms[id].name;
+  }
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return syms.size();
+  }
+};
+
+// Live and peak heap bytes of one interpreter instance, for its heap budget:
+// atom slots (see ISAtomPool) and the string buffers of its atoms (see
+// ISAtomStr).
+struct ISHeapMeter {
+  size_t nLiveBytes = 0;
+  size_t nPeakBytes = 0;
+  size_t byteBudget = 0;    // 0: unlimited
+  bool overBudget = false;  // sticky, set once live bytes exceed byteBudget
+
+  void charge(size_t n) {
+    nLiveBytes += n;
+    if (nLiveBytes > nPeakBytes) nPeakBytes = nLiveBytes;
+    if (byteBudget && nLiveBytes > byteBudget) overBudget = true;
+  }
+  void credit(size_t n) {
+    nLiveBytes -= n;
+  }
+};
+
+// String payload of STRING, SYMBOL and ERROR atoms: one tagged word, so that
+// atoms without text don't carry a full std::string. Either null (""), a
+// shared immutable buffer, or (low bit set) a borrowed interned symbol,
+// which makes copies of symbol atoms free and their id available without
+// a lookup. Buffers are reference counted, copying an atom only bumps the
+// count; short values stay in the buffer's std::string inline storage, so
+// they cost a single allocation. Reads as a const string &.
+class ISStr {
+  struct Buf {
+    unsigned int refs;
+    string s;
+  };
+  uintptr_t h;
+
+  static const string &emptyStr() {
+    static const string empty;
+    return empty;
+  }
+  static uintptr_t newBuf(string &&s) {
+    if (s.empty()) return 0;
+    return (uintptr_t) new Buf{1, std::move(s)};
+  }
+  bool isSym() const {
+    return h & 1;
+  }
+  const ISSymbol *sym() const {
+    return (const ISSymbol *)(h & ~(uintptr_t)1);
+  }
+  Buf *buf() const {
+    return isSym() ? nullptr : (Buf *)h;
+  }
+  uintptr_t share() const {
+    if (buf()) buf()->refs++;
+    return h;
+  }
+  void release() {
+    Buf *pb = buf();
+    if (pb && --pb->refs == 0) delete pb;
+    h = 0;
+  }
+
+  public:
+  ISStr() : h(0) {}
+  ISStr(const string &s) : h(newBuf(string(s))) {}
+  ISStr(string &&s) : h(newBuf(std::move(s))) {}
+  ISStr(const char *s) : h(newBuf(string(s))) {}
+  ISStr(const ISStr &o) : h(o.share()) {}
+  ISStr(ISStr &&o) : h(o.h) {
+    o.h = 0;
+  }
+  ~ISStr() {
+    release();
+  }
+  ISStr &operator=(const ISStr &o) {
+    if (this != &o) {
+      uintptr_t oh = o.share();
+      release();
+      h = oh;
+    }
+    return *this;
+  }
+  ISStr &operator=(ISStr &&o) {
+    std::swap(h, o.h);
+    return *this;
+  }
+  static ISStr intern(const string &name) {
+    ISStr s;
+    s.h = (uintptr_t)ISSymbolTable::global().intern(name) | 1;
+    return s;
+  }
+  static int symbolId(const string &name) {
+    return ISSymbolTable::global().intern(name)->id;
+  }
+  int symId() const {  // id of the symbol with this name, interned on demand
+    return isSym() ? sym()->id : symbolId(str());
+  }
+  int findSymId() const {  // as symId() for runtime strings, -1 if no such symbol exists
+    return isSym() ? sym()->id : ISSymbolTable::global().find(str());
+  }
+  const string &str() const {
+    if (isSym()) return sym()->name;
+    return h ? buf()->s : emptyStr();
+  }
+  operator const string &() const {
+    return str();
+  }
+  const char *c_str() const {
+    return str().c_str();
+  }
+  size_t length() const {
+    return str().length();
+  }
+  bool empty() const {
+    return length() == 0;
+  }
+  size_t heapBytes() const {  // of the buffer, shared or not; symbols are not counted
+    return buf() ? sizeof(Buf) + buf()->s.capacity() : 0;
+  }
+  string substr(size_t pos, size_t len = string::npos) const {
+    return str().substr(pos, len);
+  }
+  string::const_iterator begin() const {
+    return str().begin();
+  }
+  string::const_iterator end() const {
+    return str().end();
+  }
+  ISStr &operator+=(const string &s) {  // copy on write
+    if (!buf() || buf()->refs > 1) {
+      uintptr_t nh = newBuf(str() + s);
+      release();
+      h = nh;
+    } else {
+      buf()->s += s;
+    }
+    return *this;
+  }
+  ISStr &operator+=(const char *s) {
+    return *this += string(s);
+  }
+  ISStr &operator+=(char c) {
+    return *this += string(1, c);
+  }
+};
+
+inline bool operator==(const ISStr &a, const ISStr &b) {
+  return a.str() == b.str();
+}
+inline bool operator==(const ISStr &a, const string &b) {
+  return a.str() == b;
+}
+inline bool operator==(const string &a, const ISStr &b) {
+  return a == b.str();
+}
+inline bool operator==(const ISStr &a, const char *b) {
+  return a.str() == b;
+}
+inline bool operator!=(const ISStr &a, const ISStr &b) {
+  return !(a == b);
+}
+inline bool operator!=(const ISStr &a, const string &b) {
+  return !(a == b);
+}
+inline bool operator!=(const string &a, const ISStr &b) {
+  return !(a == b);
+}
+inline bool operator!=(const ISStr &a, const char *b) {
+  return !(a == b);
+}
+inline bool operator<(const ISStr &a, const ISStr &b) {
+  return a.str() < b.str();
+}
+inline bool operator>(const ISStr &a, const ISStr &b) {
+  return b < a;
+}
+inline bool operator<=(const ISStr &a, const ISStr &b) {
+  return !(b < a);
+}
+inline bool operator>=(const ISStr &a, const ISStr &b) {
+  return !(a < b);
+}
+inline string operator+(const ISStr &a, const string &b) {
+  return a.str() + b;
+}
+inline string operator+(const string &a, const ISStr &b) {
+  return a + b.str();
+}
+inline string operator+(const ISStr &a, const char *b) {
+  return a.str() + b;
+}
+inline string operator+(const char *a, const ISStr &b) {
+  return a + b.str();
+}
+inline std::ostream &operator<<(std::ostream &os, const ISStr &s) {
+  return os << s.str();
+}
+
+// Atom slabs (see ISAtomPool) are ISSlabBytes large and aligned to their size.
+// Their first cell holds the heap meter of the owning pool, so anything inside
+// an atom finds the meter of its instance from its own address.
+const size_t ISSlabBytes = 1 << 16;
+struct ISSlabHead {
+  ISHeapMeter *pMeter;
+};
+
+inline ISHeapMeter *slabMeter(const void *p) {
+  return ((const ISSlabHead *)((uintptr_t)p & ~(uintptr_t)(ISSlabBytes - 1)))->pMeter;
+}
+
+// The vals of an atom: charges the buffer it refers to to the heap meter of
+// the atom's pool, once per atom that refers to it, so string bytes are always
+// counted by the instance holding them, also for buffers shared between instances.
+class ISAtomStr : public ISStr {
+  void recharge(size_t nOld) {
+    size_t n = heapBytes();
+    if (n > nOld) slabMeter(this)->charge(n - nOld);
+    if (n < nOld) slabMeter(this)->credit(nOld - n);
+  }
+
+  public:
+  ISAtomStr() {}
+  ISAtomStr(const ISAtomStr &o) : ISStr(o) {
+    recharge(0);
+  }
+  ~ISAtomStr() {
+    slabMeter(this)->credit(heapBytes());
+  }
+  ISAtomStr &operator=(const ISStr &o) {
+    size_t n = heapBytes();
+    ISStr::operator=(o);
+    recharge(n);
+    return *this;
+  }
+  ISAtomStr &operator=(ISStr &&o) {
+    size_t n = heapBytes();
+    ISStr::operator=(std::move(o));
+    recharge(n);
+    return *this;
+  }
+  ISAtomStr &operator=(const ISAtomStr &o) {
+    return *this = (const ISStr &)o;
+  }
+  ISAtomStr &operator=(ISAtomStr &&o) {  // shares, o stays charged to its own atom
+    return *this = (const ISStr &)o;
+  }
+  template <class T>
+  ISAtomStr &operator+=(const T &s) {
+    size_t n = heapBytes();
+    ISStr::operator+=(s);
+    recharge(n);
+    return *this;
+  }
+};
+
+// Namespace indexed by symbol id. A default-constructed T (nullptr, empty
+// std::function) marks an unbound name.
+template <class T>
+class ISSymMap {
+  vector<T> entries;
+
+  public:
+  bool contains(int id) const {
+    return id >= 0 && id < (int)entries.size() && entries[id];
+  }
+  T &operator[](int id) {
+    if (id >= (int)entries.size()) entries.resize(id + 1);
+    return entries[id];
+  }
+  T &operator[](const string &name) {
+    return (*this)[ISStr::symbolId(name)];
+  }
+  T &operator[](const char *name) {
+    return (*this)[ISStr::symbolId(name)];
+  }
+  void erase(int id) {
+    if (contains(id)) entries[id] = T();
+  }
+  vector<int> ids() const {  // bound ids, in id order
+    vector<int> bound;
+    for (int id = 0; id < (int)entries.size(); id++) {
+      if (entries[id]) bound.push_back(id);
+    }
+    return bound;
+  }
+};
+
 class ISAtom {
   public:
-  enum TokType { NIL = 0,
+  enum TokType : unsigned char { NIL = 0,
                  ERROR = 1,
                  INT,
                  FLOAT,
@@ -24,14 +365,19 @@ class ISAtom {
                  SYMBOL,
                  QUOTE,
                  LIST,
+                 CLOSURE,
                  INVALID };
   enum DecorType { NONE = 0,
                    ASCII = 1,
                    UNICODE = 2 };
+  // 40 bytes: tag and int share the first word, then the double, the string
+  // word and both links. A union of val and valf would still take its own
+  // word next to the tag; 32 bytes or less would need valf to overlay vals or
+  // a link, which are read and retyped without checking t in many places.
   TokType t;
   int val;
   double valf;
-  string vals;
+  ISAtomStr vals;  // atoms live in an ISAtomPool only
   ISAtom *pNext;
   ISAtom *pChild;
   ISAtom() {
@@ -40,7 +386,6 @@ class ISAtom {
     t = NIL;
     val = 0;
     valf = 0.0;
-    vals = "";
   }
   string str(const DecorType decor = NONE) const {
     string out;
@@ -64,6 +409,19 @@ class ISAtom {
     case ISAtom::TokType::LIST:
       out = "(";
       break;
+    case ISAtom::TokType::CLOSURE:
+      switch (decor) {
+      case ASCII:
+        out = "(l)";
+        break;
+      case UNICODE:
+        out = "ⓛ ";
+        break;
+      case NONE:
+        out = "";
+        break;
+      }
+      break;
     case ISAtom::TokType::INT:
       switch (decor) {
       case ASCII:
@@ -151,113 +509,793 @@ class ISAtom {
     return out;
   }
 };
+static_assert(sizeof(ISAtom) <= 2 * sizeof(double) + 3 * sizeof(void *), "ISAtom grew beyond its five words");
+
+// Memory-debugging policies for ISAtomPool. ISMemRelease does no bookkeeping
+// at all; ISMemDebug remembers, per slot, where an atom was freed (as a
+// compact id into a table of deleteList()/gcd() context names) so that
+// double frees and leaks can be reported. Select with -DINSCH_MEMDBG.
+struct ISMemRelease {
+  static const bool memDbg = false;
+  struct SlotInfo {};
+  void onFree(SlotInfo &, const char *) {}
+  const char *freedAt(const SlotInfo &) const {
+    return nullptr;
+  }
+};
 
-class IndraScheme {
+struct ISMemDebug {
+  static const bool memDbg = true;
+  struct SlotInfo {
+    unsigned int delCtx = 0;  // 0: never freed, else index + 1 into ctxNames
+  };
+  vector<const char *> ctxNames;
+  map<const char *, unsigned int> ctxIds;
+
+  void onFree(SlotInfo &info, const char *context) {
+    auto pos = ctxIds.find(context);
+    if (pos == ctxIds.end()) {
+      ctxNames.push_back(context);
+      pos = ctxIds.insert({context, (unsigned int)ctxNames.size()}).first;
+    }
+    info.delCtx = pos->second;
+  }
+  const char *freedAt(const SlotInfo &info) const {
+    if (info.delCtx == 0) return nullptr;
+    return ctxNames[info.delCtx - 1];
+  }
+};
+
+#ifdef INSCH_MEMDBG
+typedef ISMemDebug ISMemPolicy;
+#else
+typedef ISMemRelease ISMemPolicy;
+#endif
+
+// Slab allocator for ISAtom: fixed-size slots carved out of large blocks,
+// O(1) alloc/free via an intrusive free list. Each slot keeps a state byte,
+// so accounting (gc_size()) and double-free detection need no registry.
+// Slabs start with an ISSlabHead pointing back to the pool.
+template <class MemPolicy>
+class ISAtomPool : public ISHeapMeter {
   public:
-  map<string, std::function<ISAtom *(ISAtom *, vector<map<string, ISAtom *>> &)>> inbuilts;
-  map<string, ISAtom *> symbols;
-  map<string, ISAtom *> funcs;
-  vector<string> tokTypeNames = {"Nil", "Error", "Int", "Float", "String", "Boolean", "Symbol", "Quote", "List", "Invalid: internal error"};
-  map<ISAtom *, size_t> gctr;
-  bool memDbg = true;
+  enum SlotState { FREE = 0,
+                   REGISTERED = 1,
+                   UNREGISTERED = 2 };
+  struct Slot {
+    union {
+      alignas(ISAtom) unsigned char storage[sizeof(ISAtom)];  // must stay first: ISAtom * <-> Slot *
+      Slot *pNextFree;
+    };
+    unsigned int refs;  // owners of this atom and everything reachable from it
+    unsigned char state;
+    typename MemPolicy::SlotInfo info;
+  };
+  static const size_t slabSize = ISSlabBytes / sizeof(Slot) - 1;  // the first cell holds the ISSlabHead
+  static const size_t quarantineSize = 64;
+
+  MemPolicy policy;
+  vector<Slot *> slabs;
+  Slot *pFree = nullptr;
+  Slot *quarantine[quarantineSize] = {};  // recently freed slots, not yet on pFree
+  size_t quarantinePos = 0;
+  size_t slabUsed = slabSize;  // bump index into slabs.back()
+  size_t nRegistered = 0;
+  size_t nUnregistered = 0;
+  size_t nAllocs = 0;  // total allocations, drives the tracing collector's trigger
+
+  ISAtomPool() {}
+  ISAtomPool(const ISAtomPool &) = delete;
+  ISAtomPool &operator=(const ISAtomPool &) = delete;
+  ~ISAtomPool() {
+    for (Slot *pSlab : slabs) {
+      for (size_t i = 0; i < slabSize; i++) {
+        if (pSlab[i].state != FREE) ((ISAtom *)pSlab[i].storage)->~ISAtom();
+      }
+      ::free(pSlab - 1);
+    }
+  }
 
-  IndraScheme() {
-    for (auto cm_op : "+-*/%") {
-      if (cm_op == 0) continue;
-      string m_op{cm_op};
-      inbuilts[m_op] = [this, m_op](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return math_2ops(pisa, local_symbols, m_op); };
-    }
-    for (auto cmp_op : {"==", "!=", ">=", "<=", "<", ">", "and", "or"}) {
-      string m_op{cmp_op};
-      inbuilts[m_op] = [this, m_op](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return cmp_2ops(pisa, local_symbols, m_op); };
-    }
-    inbuilts["define"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return makeDefine(pisa, local_symbols); };
-    inbuilts["let"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return makeLocalDefine(pisa, local_symbols); };
-    inbuilts["set!"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return setLocalDefine(pisa, local_symbols); };
-    inbuilts["begin"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return evalBegin(pisa, local_symbols); };
-    inbuilts["if"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return evalIf(pisa, local_symbols); };
-    inbuilts["cond"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return evalCond(pisa, local_symbols); };
-    inbuilts["while"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return evalWhile(pisa, local_symbols); };
-    inbuilts["print"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return evalPrint(pisa, local_symbols); };
-    inbuilts["indentedstringify"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return evalIndentedStringify(pisa, local_symbols); };
-    inbuilts["stringify"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return evalStringify(pisa, local_symbols); };
-    inbuilts["listfunc"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return evalListfunc(pisa, local_symbols); };
-    inbuilts["load"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return evalLoad(pisa, local_symbols); };
-    inbuilts["parse"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return evalParse(pisa, local_symbols); };
-    inbuilts["quote"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return evalQuote(pisa, local_symbols); };
-    inbuilts["list"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return listList(pisa, local_symbols); };
-    inbuilts["cons"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return listCons(pisa, local_symbols); };
-    inbuilts["car"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return listCar(pisa, local_symbols); };
-    inbuilts["cdr"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return listCdr(pisa, local_symbols); };
-    inbuilts["length"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return listLength(pisa, local_symbols); };
-    inbuilts["append"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return listAppend(pisa, local_symbols); };
-    inbuilts["reverse"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return listReverse(pisa, local_symbols); };
-    inbuilts["index"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return listIndex(pisa, local_symbols); };
-    inbuilts["range"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return listRange(pisa, local_symbols); };
-    inbuilts["sublist"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return listSublist(pisa, local_symbols); };
-    inbuilts["splitstring"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return stringSplitstring(pisa, local_symbols); };
-    inbuilts["substring"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return stringSubstring(pisa, local_symbols); };
-    inbuilts["lowercase"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return stringLowercase(pisa, local_symbols); };
-    inbuilts["uppercase"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return stringUppercase(pisa, local_symbols); };
-    inbuilts["replacestring"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return stringReplace(pisa, local_symbols); };
-    inbuilts["find"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return evalFind(pisa, local_symbols); };
-
-    inbuilts["eval"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return evalEval(pisa, local_symbols); };
-    inbuilts["type"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return evalType(pisa, local_symbols); };
-    inbuilts["convtype"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return evalConvtype(pisa, local_symbols); };
-
-    inbuilts["every"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return evalEvery(pisa, local_symbols); };
-    inbuilts["map"] = [&](ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) -> ISAtom * { return evalMap(pisa, local_symbols); };
+  static Slot *slot(const ISAtom *pisa) {
+    return (Slot *)pisa;
   }
 
-  ISAtom *gca(const ISAtom *src = nullptr, bool bRegister = true) {
+  SlotState state(const ISAtom *pisa) const {
+    return (SlotState)slot(pisa)->state;
+  }
+
+  ISAtom *alloc(const ISAtom *src, bool bRegister) {
+    Slot *ps;
+    if (pFree) {
+      ps = pFree;
+      pFree = ps->pNextFree;
+    } else {
+      if (slabUsed == slabSize) {
+        void *pMem;
+        if (posix_memalign(&pMem, ISSlabBytes, ISSlabBytes)) throw std::bad_alloc();
+        ((ISSlabHead *)pMem)->pMeter = this;
+        Slot *pSlab = (Slot *)pMem + 1;
+        for (size_t i = 0; i < slabSize; i++) {
+          new (&pSlab[i]) Slot();
+          pSlab[i].state = FREE;
+        }
+        slabs.push_back(pSlab);
+        slabUsed = 0;
+      }
+      ps = &slabs.back()[slabUsed++];
+    }
     ISAtom *nisa;
     if (src == nullptr) {
-      nisa = new ISAtom();
+      nisa = new (ps->storage) ISAtom();
     } else {
-      nisa = new ISAtom(*src);
+      nisa = new (ps->storage) ISAtom(*src);
       nisa->pNext = nullptr;
       nisa->pChild = nullptr;
     }
-    if (bRegister) gctr[nisa] = 1;
+    ps->refs = 1;
+    ++nAllocs;
+    if (bRegister) {
+      ps->state = REGISTERED;
+      ++nRegistered;
+    } else {
+      ps->state = UNREGISTERED;
+      ++nUnregistered;
+    }
+    charge(sizeof(Slot));
     return nisa;
   }
 
-  map<ISAtom *, string> gctr_del_ctx;
+  unsigned int refs(const ISAtom *pisa) const {
+    return slot(pisa)->refs;
+  }
 
-  void gcd(ISAtom *pisa, string context, bool bUnregistered = false) {
-    if (!pisa) return;
-    auto pos = gctr.find(pisa);
-    if (pos == gctr.end()) {
-      if (memDbg && !bUnregistered) {
-        cout << "Trying to delete unaccounted allocation at " << context << " of: " << pisa << ", ";
-        vector<map<string, ISAtom *>> lh;
-        lh.push_back({});
-        print(pisa, lh, ISAtom::DecorType::UNICODE, true);
-        cout << endl;
-        if (gctr_del_ctx.find(pisa) != gctr_del_ctx.end()) {
-          cout << "This has been deleted at context: " << gctr_del_ctx[pisa] << endl;
+  void share(ISAtom *pisa) {
+    ++slot(pisa)->refs;
+  }
+
+  bool unshare(ISAtom *pisa) {  // drop a reference, true if others remain
+    Slot *ps = slot(pisa);
+    if (ps->refs <= 1) return false;
+    --ps->refs;
+    return true;
+  }
+
+  void free(ISAtom *pisa, const char *context) {
+    Slot *ps = slot(pisa);
+    if (ps->state == FREE) return;
+    if (ps->state == REGISTERED)
+      --nRegistered;
+    else
+      --nUnregistered;
+    pisa->~ISAtom();
+    credit(sizeof(Slot));
+    policy.onFree(ps->info, context);
+    ps->state = FREE;
+    // Freed slots wait in a short FIFO before reuse, so a second delete of the
+    // same atom still finds it FREE in release builds too.
+    Slot *pOld = quarantine[quarantinePos];
+    quarantine[quarantinePos] = ps;
+    quarantinePos = (quarantinePos + 1) % quarantineSize;
+    if (pOld) {
+      pOld->pNextFree = pFree;
+      pFree = pOld;
+    }
+  }
+
+  const char *freedAt(const ISAtom *pisa) const {
+    return policy.freedAt(slot(pisa)->info);
+  }
+
+  size_t size() const {
+    return nRegistered;
+  }
+
+  size_t liveBytes() const {
+    return nLiveBytes;
+  }
+
+  size_t peakBytes() const {
+    return nPeakBytes;
+  }
+
+  // Tracing collection: clearMarks() zeroes every live reference count,
+  // mark() re-counts one reference per root and per pChild/pNext edge of
+  // reachable atoms, sweep() frees all atoms left at zero. Reachable atoms
+  // end up with exact reference counts again.
+  void clearMarks() {
+    for (Slot *pSlab : slabs) {
+      for (size_t i = 0; i < slabSize; i++)
+        pSlab[i].refs = 0;
+    }
+  }
+
+  void mark(const ISAtom *root, vector<const ISAtom *> &stack) {
+    if (root == nullptr) return;
+    stack.push_back(root);
+    while (stack.size() > 0) {
+      const ISAtom *p = stack.back();
+      stack.pop_back();
+      if (slot(p)->refs++ > 0) continue;
+      if (p->pChild) stack.push_back(p->pChild);
+      if (p->pNext) stack.push_back(p->pNext);
+    }
+  }
+
+  size_t sweep(const char *context) {
+    size_t nFreed = 0;
+    for (Slot *pSlab : slabs) {
+      for (size_t i = 0; i < slabSize; i++) {
+        if (pSlab[i].state != FREE && pSlab[i].refs == 0) {
+          pSlab[i].refs = 1;
+          free((ISAtom *)pSlab[i].storage, context);
+          ++nFreed;
         }
-      } else {
-        delete pisa;
       }
+    }
+    return nFreed;
+  }
+
+  vector<ISAtom *> liveAtoms(bool bRegisteredOnly) const {
+    vector<ISAtom *> live;
+    for (Slot *pSlab : slabs) {
+      for (size_t i = 0; i < slabSize; i++) {
+        if (pSlab[i].state == REGISTERED || (!bRegisteredOnly && pSlab[i].state == UNREGISTERED)) live.push_back((ISAtom *)pSlab[i].storage);
+      }
+    }
+    return live;
+  }
+};
+
+// One scope of local variables. Bindings stay in insertion order, so a binding's
+// slot index is stable for the lifetime of the frame and compiled code can
+// address it directly, see IndraScheme::vmResolve().
+class ISFrame {
+  vector<std::pair<int, ISAtom *>> slots;
+
+  public:
+  typedef vector<std::pair<int, ISAtom *>>::iterator iterator;
+  typedef vector<std::pair<int, ISAtom *>>::const_iterator const_iterator;
+  iterator begin() {
+    return slots.begin();
+  }
+  iterator end() {
+    return slots.end();
+  }
+  const_iterator begin() const {
+    return slots.begin();
+  }
+  const_iterator end() const {
+    return slots.end();
+  }
+  iterator find(int id) {
+    for (auto it = slots.begin(); it != slots.end(); ++it) {
+      if (it->first == id) return it;
+    }
+    return slots.end();
+  }
+  const_iterator find(int id) const {
+    for (auto it = slots.begin(); it != slots.end(); ++it) {
+      if (it->first == id) return it;
+    }
+    return slots.end();
+  }
+  ISAtom *&operator[](int id) {
+    auto it = find(id);
+    if (it != slots.end()) return it->second;
+    slots.push_back({id, nullptr});
+    return slots.back().second;
+  }
+  ISAtom *&slot(int i) {
+    return slots[i].second;
+  }
+  size_t size() const {
+    return slots.size();
+  }
+  void clear() {
+    slots.clear();
+  }
+  void swap(ISFrame &other) {
+    slots.swap(other.slots);
+  }
+};
+
+// Stack of local scopes, innermost last. Popped frames keep their storage, so
+// entering a function or let doesn't allocate once the stack was that deep before.
+class ISScopes {
+  vector<ISFrame> frames;
+  size_t nFrames = 0;
+
+  public:
+  size_t size() const {
+    return nFrames;
+  }
+  ISFrame &operator[](size_t i) {
+    return frames[i];
+  }
+  const ISFrame &operator[](size_t i) const {
+    return frames[i];
+  }
+  ISFrame &back() {
+    return frames[nFrames - 1];
+  }
+  void push_back(ISFrame &&frame) {
+    if (nFrames == frames.size()) {
+      frames.push_back(std::move(frame));
+    } else if (frame.size()) {
+      frames[nFrames] = std::move(frame);
+    }
+    ++nFrames;
+  }
+  void pop_back() {
+    frames[--nFrames].clear();
+  }
+  ISFrame *begin() {
+    return frames.data();
+  }
+  ISFrame *end() {
+    return frames.data() + nFrames;
+  }
+};
+
+struct ISFunc;
+
+// Bytecode of a user function body, see IndraScheme::analyzeFunc() and vmRun().
+// Each op mirrors one step of the tree walker, p points into the (folded) body.
+struct ISOp {
+  enum Code : unsigned char { CONST,
+                              SYM,
+                              LOCAL,
+                              QUOTED,
+                              QUOTE_ATOM,
+                              LOAD,
+                              EVAL,
+                              EVAL_ATOM,
+                              EVAL_FN,
+                              BUILTIN,
+                              MARK,
+                              BAIL,
+                              CHAIN,
+                              MATH,
+                              CMP,
+                              JUMP,
+                              JUMP_IF_ERROR,
+                              POP,
+                              NIL,
+                              PUSH_NULL,
+                              NULL_TO_NIL,
+                              IF_TEST,
+                              COND_TEST,
+                              WHILE_TEST,
+                              BUDGET,
+                              SET_CHECK,
+                              SET,
+                              SET_LOCAL,
+                              SCOPE_PUSH,
+                              SCOPE_POP,
+                              COPYLIST,
+                              COPY_NIL,
+                              BIND,
+                              ARG_NAME,
+                              CALL,
+                              CALL_LAMBDA,  // CALL of the lambda pCached, compiled with the body
+                              CLOSURE,      // closure of the lambda compiled as pCached, p its anchor
+                              BIND_PARAM,
+                              INVOKE,
+                              // Fused forms, each followed by the generic ops it stands
+                              // for. They run in one step if the operand types allow it and
+                              // continue at c, else the generic ops run.
+                              MATH2,        // (op x y), x and y locals (a, b) or literals (-1)
+                              CMP2,         // (cmp x y), as MATH2
+                              ADD_LOCAL };  // (set! x (+ x k)): local a += b
+  Code op;
+  int a, b, c;
+  const ISAtom *p;
+  mutable unsigned cacheEpoch;   // CALL: inline cache of the callee, valid while
+  mutable const ISFunc *pCached;  // cacheEpoch equals IndraScheme::defEpoch
+};
+
+// Int code of a function specialized on INT arguments, see IndraScheme::specCompile().
+// Values are plain ints (booleans 0/1) on an operand stack and in registers, the
+// parameters in the first ones.
+struct ISIntOp {
+  enum Code : unsigned char { CONST,
+                              LOAD,   // push register a
+                              STORE,  // pop into register a
+                              ADD,    // ADD..MOD in MathOp order
+                              SUB,
+                              MUL,
+                              DIV,
+                              MOD,
+                              EQ,  // EQ..OR in CmpOp order
+                              NE,
+                              GE,
+                              LE,
+                              LT,
+                              GT,
+                              AND,
+                              OR,
+                              JUMP,
+                              JUMP_FALSE,
+                              POP,
+                              CALL,   // pFn with the b arguments in registers a...
+                              TAIL,   // self tail call, as CALL
+                              DEOPT,  // not covered: evaluate the call generically
+                              RET };
+  Code op;
+  int a, b;
+  const ISFunc *pFn;
+};
+
+class IndraScheme;
+typedef bool (*ISJitFunc)(IndraScheme *, const int *args, int *res);
+
+struct ISIntCode {
+  vector<ISIntOp> ops;
+  int nParams = 0;
+  int nRegs = 0;
+  bool bBoolResult = false;
+  unsigned epoch = 0;     // IndraScheme::defEpoch it was compiled in
+  mutable int nRuns = 0;  // native code is generated after IndraScheme::jitThreshold runs
+  mutable ISJitFunc pJit = nullptr;
+  mutable void *pJitMem = nullptr;
+  mutable size_t jitSize = 0;
+  ISIntCode() {}
+  ISIntCode(const ISIntCode &) = delete;
+  ISIntCode &operator=(const ISIntCode &) = delete;
+  ~ISIntCode() {
+#ifdef INSCH_JIT
+    if (pJitMem) munmap(pJitMem, jitSize);
+#endif
+  }
+};
+
+// A user function as analyzed once by makeDefine(): arity, parameter ids and compiled body.
+struct ISFunc {
+  int serial = 0;  // unique per definition, compiled calls and natives check it before relying on it
+  int nParams = 0;
+  vector<int> paramIds;
+  const ISAtom *pBody = nullptr;  // constant folded copy of the body, ops point into it
+  vector<ISOp> ops;
+  // Type feedback and int specialization, see IndraScheme::specEnter()
+  mutable int nCalls = 0;
+  mutable int nSpecAttempts = 0;
+  mutable int nDeopts = 0;
+  mutable unsigned argTypes = 0;     // a bit per TokType passed as parameter
+  mutable unsigned resultTypes = 0;  // a bit per TokType returned
+  mutable std::unique_ptr<ISIntCode> pIntCode;
+  vector<ISAtom *> lambdas;           // anchors of the lambdas compiled with the body
+  vector<const ISAtom *> captures;    // lambdas: free symbols, bound from the closure's environment
+  vector<const ISAtom *> mapForms;    // in-place lambdas of map and every, see IndraScheme::mapLambdas
+};
+
+class IndraScheme {
+  public:
+  // Builtins dispatch through a member function pointer table indexed by symbol id.
+  // Embedding projects can add their own with add_inbuilt().
+  typedef ISAtom *(IndraScheme::*Inbuilt)(const ISAtom *, ISScopes &);
+  typedef std::function<ISAtom *(const ISAtom *, ISScopes &)> ExtInbuilt;
+  ISSymMap<Inbuilt> inbuilts;
+  ISSymMap<ExtInbuilt> extInbuilts;
+  ISSymMap<ISAtom *> symbols;
+  ISSymMap<ISAtom *> funcs;
+  vector<string> tokTypeNames = {"Nil", "Error", "Int", "Float", "String", "Boolean", "Symbol", "Quote", "List", "Closure", "Invalid: internal error"};
+  typedef ISAtomPool<ISMemPolicy> AtomPool;
+  AtomPool gcpool;
+  static const bool memDbg = ISMemPolicy::memDbg;
+
+  IndraScheme() {
+    static const struct {
+      const char *name;
+      Inbuilt fn;
+    } inbuiltTable[] = {
+        {"+", &IndraScheme::math_op<MATH_ADD>},
+        {"-", &IndraScheme::math_op<MATH_SUB>},
+        {"*", &IndraScheme::math_op<MATH_MUL>},
+        {"/", &IndraScheme::math_op<MATH_DIV>},
+        {"%", &IndraScheme::math_op<MATH_MOD>},
+        {"==", &IndraScheme::cmp_op<CMP_EQ>},
+        {"!=", &IndraScheme::cmp_op<CMP_NE>},
+        {">=", &IndraScheme::cmp_op<CMP_GE>},
+        {"<=", &IndraScheme::cmp_op<CMP_LE>},
+        {"<", &IndraScheme::cmp_op<CMP_LT>},
+        {">", &IndraScheme::cmp_op<CMP_GT>},
+        {"and", &IndraScheme::cmp_op<CMP_AND>},
+        {"or", &IndraScheme::cmp_op<CMP_OR>},
+        {"define", &IndraScheme::makeDefine},
+        {"let", &IndraScheme::makeLocalDefine},
+        {"set!", &IndraScheme::setLocalDefine},
+        {"begin", &IndraScheme::evalBegin},
+        {"if", &IndraScheme::evalIf},
+        {"cond", &IndraScheme::evalCond},
+        {"while", &IndraScheme::evalWhile},
+        {"print", &IndraScheme::evalPrint},
+        {"indentedstringify", &IndraScheme::evalIndentedStringify},
+        {"stringify", &IndraScheme::evalStringify},
+        {"listfunc", &IndraScheme::evalListfunc},
+        {"load", &IndraScheme::evalLoad},
+        {"parse", &IndraScheme::evalParse},
+        {"quote", &IndraScheme::evalQuote},
+        {"list", &IndraScheme::listList},
+        {"cons", &IndraScheme::listCons},
+        {"car", &IndraScheme::listCar},
+        {"cdr", &IndraScheme::listCdr},
+        {"length", &IndraScheme::listLength},
+        {"append", &IndraScheme::listAppend},
+        {"reverse", &IndraScheme::listReverse},
+        {"index", &IndraScheme::listIndex},
+        {"range", &IndraScheme::listRange},
+        {"sublist", &IndraScheme::listSublist},
+        {"splitstring", &IndraScheme::stringSplitstring},
+        {"substring", &IndraScheme::stringSubstring},
+        {"lowercase", &IndraScheme::stringLowercase},
+        {"uppercase", &IndraScheme::stringUppercase},
+        {"replacestring", &IndraScheme::stringReplace},
+        {"find", &IndraScheme::evalFind},
+        {"eval", &IndraScheme::evalEval},
+        {"type", &IndraScheme::evalType},
+        {"convtype", &IndraScheme::evalConvtype},
+        {"every", &IndraScheme::evalEvery},
+        {"map", &IndraScheme::evalMap},
+        {"lambda", &IndraScheme::makeLambda},
+    };
+    for (auto &entry : inbuiltTable)
+      inbuilts[entry.name] = entry.fn;
+    pTrue = gca(nullptr, false);
+    pTrue->t = ISAtom::TokType::BOOLEAN;
+    pTrue->val = 1;
+    pFalse = gca(nullptr, false);
+    pFalse->t = ISAtom::TokType::BOOLEAN;
+    pFalse->val = 0;
+    for (auto name : {"+", "-", "*", "/", "%", "lowercase", "uppercase", "replacestring"})
+      foldInbuilts[name] = FOLD_SCALARS;
+    for (auto name : {"==", "!=", ">=", "<=", "<", ">", "and", "or"})
+      foldInbuilts[name] = FOLD_SCALARS | FOLD_BOOLEANS;
+  }
+
+  void add_inbuilt(const string &name, ExtInbuilt fn) {
+    int id = ISStr::symbolId(name);
+    bool bShadows = inbuilts.contains(id) || funcs.contains(id);
+    extInbuilts[id] = fn;
+    inbuilts[id] = &IndraScheme::evalExtInbuilt;
+    foldInbuilts.erase(id);
+    ++defEpoch;  // int code took names that weren't inbuilts for locals
+    if (bShadows) reanalyzeFuncs();  // compiled bodies may have folded, lowered or called the old one
+  }
+
+  // Natively compiled functions as emitted by indrascheme-aot: fn computes the body on
+  // INT arguments like the int code of specCompile(). It is registered as an inbuilt
+  // in front of the function's definition, which runs for other arguments, whenever
+  // fn returns false and once the function or one of the callees fn calls directly
+  // has been defined anew.
+  typedef bool (*NativeInt)(const int *args, int &res);
+  typedef vector<std::pair<int, int>> NativeDefs;  // ids and serials of the definitions fn was compiled from
+  vector<int> nativeArgs;
+
+  void add_native(const string &name, NativeInt fn, bool bBoolResult, const vector<string> &callees = {}) {
+    int id = ISStr::symbolId(name);
+    NativeDefs defs;
+    for (const string &def : callees) {
+      int defId = ISStr::symbolId(def);
+      defs.push_back({defId, funcInfo.contains(defId) ? funcInfo[defId]->serial : 0});
+    }
+    defs.push_back({id, funcInfo.contains(id) ? funcInfo[id]->serial : 0});
+    add_inbuilt(name, [this, id, fn, bBoolResult, defs](const ISAtom *pisa, ISScopes &local_symbols) {
+      return call_native(id, fn, bBoolResult, defs, pisa, local_symbols);
+    });
+  }
+
+  ISAtom *call_native(int id, NativeInt fn, bool bBoolResult, const NativeDefs &defs, const ISAtom *pisa, ISScopes &local_symbols) {  // as eval_func()
+    ISAtom *pRes;
+    if (!funcInfo.contains(id)) {
+      pRes = gca();
+      pRes->t = ISAtom::TokType::ERROR;
+      pRes->vals = "Native function without definition";
+      return pRes;
+    }
+    const ISFunc *pFn = funcInfo[id].get();
+    int nArgs = pisa ? getListLen(pisa) : 0;
+    if (nArgs != pFn->nParams) {
+      pRes = gca();
+      pRes->t = ISAtom::TokType::ERROR;
+      pRes->vals = "Lambda requires " + std::to_string(pFn->nParams) + " arguments, " + std::to_string(nArgs) + " given";
+      return pRes;
+    }
+    local_symbols.push_back({});
+    bind_args(pisa, pFn->paramIds, local_symbols);
+    ISFrame &frame = local_symbols.back();
+    bool bInts = specUniqueParams(*pFn);
+    for (auto &def : defs)
+      bInts = bInts && funcInfo.contains(def.first) && funcInfo[def.first]->serial == def.second;
+    nativeArgs.resize(pFn->nParams);
+    for (int i = 0; i < pFn->nParams && bInts; i++) {
+      const ISAtom *p = frame.slot(i);
+      bInts = p->t == ISAtom::TokType::INT && !p->pNext;
+      nativeArgs[i] = p->val;
+    }
+    int v;
+    if (bInts && fn(nativeArgs.data(), v)) {
+      pRes = specBox(v, bBoolResult);
+    } else {
+      pRes = vmRun(*pFn, local_symbols);
+    }
+    pop_local_symbols(local_symbols);
+    return pRes;
+  }
+
+  ISAtom *evalExtInbuilt(const ISAtom *, ISScopes &) {  // marker, dispatched by call_inbuilt()
+    ISAtom *pRes = gca();
+    pRes->t = ISAtom::TokType::ERROR;
+    pRes->vals = "Internal: extension called without id";
+    return pRes;
+  }
+
+  ISAtom *call_inbuilt(int id, const ISAtom *pisa, ISScopes &local_symbols) {
+    Inbuilt fn = inbuilts[id];
+    if (fn == &IndraScheme::evalExtInbuilt) return extInbuilts[id](pisa, local_symbols);
+    return (this->*fn)(pisa, local_symbols);
+  }
+
+  ISAtom *gca(const ISAtom *src = nullptr, bool bRegister = true) {
+    return gcpool.alloc(src, bRegister);
+  }
+
+  void gcd(ISAtom *pisa, const char *context) {
+    if (!pisa) return;
+    if (gcpool.state(pisa) != AtomPool::FREE) {
+      gcpool.free(pisa, context);
     } else {
-      gctr_del_ctx[pisa] = context;
-      delete pisa;
-      gctr.erase(pos);
+      cout << "Trying to delete unaccounted allocation at " << context << " of: " << pisa << ", <already freed>" << endl;
+      if (gcpool.freedAt(pisa)) {
+        cout << "This has been deleted at context: " << gcpool.freedAt(pisa) << endl;
+      }
     }
   }
 
-  void gc_clear(const ISAtom *current, vector<map<string, ISAtom *>> &local_symbols, int start_index = 0) {
-    size_t gc_size, gc_freed;
-    for (auto it = gctr.cbegin(); it != gctr.cend();) {
-      delete it->first;
-      it = gctr.erase(it);
+  void gc_clear(const ISAtom *, ISScopes &, int = 0) {
+    for (ISAtom *p : gcpool.liveAtoms(true)) {
+      gcpool.free(p, "gc_clear");
     }
   }
 
   size_t gc_size() {
-    return gctr.size();
+    return gcpool.size();
+  }
+
+  vector<ISAtom *> gc_registered() {
+    return gcpool.liveAtoms(true);
+  }
+
+  // Heap budget for embedding: once live memory, atoms and their string buffers,
+  // exceeds the budget, the running top-level evaluation unwinds with an ERROR
+  // atom and the next one starts afresh. 0 is unlimited. Setting a budget
+  // re-arms an exceeded one.
+  void set_heap_budget(size_t nBytes) {
+    gcpool.byteBudget = nBytes;
+    gcpool.overBudget = nBytes && gcpool.liveBytes() > nBytes;
+  }
+
+  size_t heap_bytes() {
+    return gcpool.liveBytes();
+  }
+
+  size_t heap_peak_bytes() {
+    return gcpool.peakBytes();
+  }
+
+  // Canonical #t/#f, unregistered and never released: the interpreter keeps
+  // one reference, results are shareList() references to them.
+  ISAtom *pTrue = nullptr;
+  ISAtom *pFalse = nullptr;
+
+  ISAtom *heapError() {
+    ISAtom *pRes = gca();
+    pRes->t = ISAtom::TokType::ERROR;
+    pRes->vals = "Heap budget of " + std::to_string(gcpool.byteBudget) + " bytes exceeded";
+    return pRes;
+  }
+
+  // Nursery: region of short-lived temporaries. An evaluation step takes a
+  // nursery_mark(), parks its scratch atoms with nursery_add() and frees them
+  // in bulk with nursery_release(mark); values that escape (the result) are
+  // simply never added. The outermost evaluation releases everything left.
+  // Nursery entries are in-flight roots for gc_collect().
+  vector<ISAtom *> nursery;
+
+  size_t nursery_mark() {
+    return nursery.size();
+  }
+
+  ISAtom *nursery_add(ISAtom *pisa) {
+    nursery.push_back(pisa);
+    return pisa;
+  }
+
+  void nursery_release(size_t mark) {
+    while (nursery.size() > mark) {
+      deleteList(nursery.back(), "nursery");
+      nursery.pop_back();
+    }
+  }
+
+  // Opt-in tracing collector. Roots are symbols, funcs, the local_symbols
+  // stack and everything on gc_roots (in-flight temporaries). With
+  // gcTracing set, a chainEval() called directly by the host collects
+  // between its top-level expressions once gcThreshold atoms have been
+  // allocated; hosts that keep atoms across evaluations must gc_protect()
+  // them. Manually released atoms are unaffected, leaked ones are reclaimed.
+  bool gcTracing = false;
+  size_t gcThreshold = 1 << 16;
+  size_t gcLastAllocs = 0;
+  int evalDepth = 0;
+
+  // Held by every evaluation entry point; when the outermost evaluation
+  // returns, whatever was deferred until nothing runs is released.
+  struct EvalDepthGuard {
+    IndraScheme &ins;
+    EvalDepthGuard(IndraScheme &ins) : ins(ins) {
+      ++ins.evalDepth;
+    }
+    ~EvalDepthGuard() {
+      if (--ins.evalDepth == 0) ins.evalFinished();
+    }
+  };
+
+  void evalFinished() {
+    nursery_release(0);
+    release_retired_funcs();
+    gcpool.overBudget = false;  // the exceeding evaluation has unwound, the next one may run
+  }
+  vector<const ISAtom *> gc_roots;
+  vector<const ISAtom *> gcMarkStack;
+
+  void gc_protect(const ISAtom *pisa) {
+    gc_roots.push_back(pisa);
+  }
+
+  void gc_unprotect(size_t n = 1) {
+    gc_roots.resize(gc_roots.size() - n);
+  }
+
+  void gc_mark_func(const ISFunc &fn, bool bBody = true) {  // retired bodies are on funcRetiredDefs
+    if (bBody) gcpool.mark(fn.pBody, gcMarkStack);
+    for (const ISAtom *pAnchor : fn.lambdas)
+      gcpool.mark(pAnchor, gcMarkStack);
+  }
+
+  size_t gc_collect(ISScopes &local_symbols) {
+    gcpool.clearMarks();
+    for (int id : symbols.ids())
+      gcpool.mark(symbols[id], gcMarkStack);
+    for (int id : funcs.ids())
+      gcpool.mark(funcs[id], gcMarkStack);
+    for (int id : funcInfo.ids())
+      gc_mark_func(*funcInfo[id]);
+    for (const ISAtom *p : funcRetiredDefs)
+      gcpool.mark(p, gcMarkStack);
+    for (auto &pFn : funcRetired)
+      gc_mark_func(*pFn, false);
+    for (auto &lf : lambdaFuncs) {  // the table holds one reference to each anchor
+      gcpool.mark(lf.first, gcMarkStack);
+      gc_mark_func(*lf.second);
+    }
+    for (const ISAtom *p : vmLambdas)
+      gcpool.mark(p, gcMarkStack);
+    for (auto &frame : local_symbols) {
+      for (auto lp : frame)
+        gcpool.mark(lp.second, gcMarkStack);
+    }
+    for (const ISAtom *p : gc_roots)
+      gcpool.mark(p, gcMarkStack);
+    for (const ISAtom *p : nursery)
+      gcpool.mark(p, gcMarkStack);
+    for (auto cp : constPool)
+      gcpool.mark(cp.second, gcMarkStack);
+    gcpool.mark(pTrue, gcMarkStack);
+    gcpool.mark(pFalse, gcMarkStack);
+    for (const ISAtom *p : vmStack)
+      gcpool.mark(p, gcMarkStack);
+    gcLastAllocs = gcpool.nAllocs;
+    return gcpool.sweep("gc_collect");
   }
 
   int getRawListLen(const ISAtom *pisa) {  // XXX NIL is counted!
@@ -299,38 +1337,80 @@ class IndraScheme {
   ISAtom *copyList(const ISAtom *pisa, bool bRegister = true) {
     if (pisa == nullptr) return nullptr;
     ISAtom *c = gca((ISAtom *)pisa, bRegister);
-    if (pisa->pChild) c->pChild = copyList(pisa->pChild, bRegister);
+    if (pisa->t == ISAtom::TokType::CLOSURE) {
+      c->pChild = copyEnv(pisa->pChild, bRegister);
+    } else if (pisa->pChild) {
+      c->pChild = copyList(pisa->pChild, bRegister);
+    }
     if (pisa->pNext) c->pNext = copyList(pisa->pNext, bRegister);
     return c;
   }
 
-  void deleteList(ISAtom *pisa, string context, bool bUnregistered = false) {
-    if (pisa == nullptr) return;
-    deleteList(pisa->pChild, context + "_C", bUnregistered);
-    deleteList(pisa->pNext, context + "_N", bUnregistered);
-    gcd(pisa, context, bUnregistered);
+  // Closures are immutable and share their environment, see makeClosure(). Unregistered
+  // copies (definitions) get their own, so they hold no registered atoms.
+  ISAtom *copyEnv(const ISAtom *pEnv, bool bRegister) {
+    if (bRegister) return shareList(pEnv);
+    ISAtom *p = gca(pEnv, false);
+    p->pChild = shareList(pEnv->pChild);
+    p->pNext = copyList(pEnv->pNext, false);
+    return p;
   }
 
-  ISAtom *copyAtom(const ISAtom *pisa, bool *pbQuoted = nullptr, bool bRegister = true) {
-    if (pisa == nullptr) {
-      ISAtom *pRes = gca(nullptr, bRegister);
-      if (pbQuoted) *pbQuoted = false;
-      return pRes;
-    }
+  ISAtom *shareList(const ISAtom *pisa) {  // new reference to an immutable (sub-)tree, released by deleteList()
+    if (pisa == nullptr) return nullptr;
+    gcpool.share((ISAtom *)pisa);
+    return (ISAtom *)pisa;
+  }
+
+  ISAtom *shareQuoted(const ISAtom *pisa) {  // value of a quoted literal: fresh head, shared immutable contents
+    ISAtom *p = gca(pisa);
+    p->pChild = shareList(pisa->pChild);
+    return p;
+  }
+
+  ISAtom *ownHead(ISAtom *pisa) {  // make the first atom of an owned reference safe to modify
+    if (pisa == nullptr || gcpool.refs(pisa) == 1) return pisa;
+    ISAtom *p = gca(pisa);
+    p->pChild = shareList(pisa->pChild);
+    p->pNext = shareList(pisa->pNext);
+    deleteList(pisa, "ownHead");
+    return p;
+  }
+
+  void deleteList(ISAtom *pisa, const char *context) {
+    if (pisa == nullptr) return;
+    if (gcpool.state(pisa) == AtomPool::FREE) {  // double delete: report, don't follow stale links
+      gcd(pisa, context);
+      return;
+    }
+    if (gcpool.unshare(pisa)) return;
+    deleteList(pisa->pChild, context);
+    deleteList(pisa->pNext, context);
+    gcd(pisa, context);
+  }
+
+  ISAtom *copyAtom(const ISAtom *pisa, bool *pbQuoted = nullptr, bool bRegister = true) {
+    if (pisa == nullptr) {
+      ISAtom *pRes = gca(nullptr, bRegister);
+      if (pbQuoted) *pbQuoted = false;
+      return pRes;
+    }
     ISAtom *p = gca(pisa, bRegister);
     ISAtom *pRet = p;
     if (p->t == ISAtom::TokType::QUOTE) {
       p->pNext = gca(pisa->pNext, bRegister);
       p = p->pNext;
       if (pisa->pNext && pisa->pNext->pChild) {
-        p->pChild = copyList(pisa->pNext->pChild);
+        p->pChild = copyList(pisa->pNext->pChild, bRegister);
       }
       if (pbQuoted) {
         *pbQuoted = true;
       }
     } else {
-      if (pisa->pChild) {
-        p->pChild = copyList(pisa->pChild);
+      if (pisa->t == ISAtom::TokType::CLOSURE) {
+        p->pChild = copyEnv(pisa->pChild, bRegister);
+      } else if (pisa->pChild) {
+        p->pChild = copyList(pisa->pChild, bRegister);
       }
       if (pbQuoted) *pbQuoted = false;
     }
@@ -432,7 +1512,7 @@ class IndraScheme {
     }
     if (is_symbol(symbol)) {
       pisa->t = ISAtom::TokType::SYMBOL;
-      pisa->vals = symbol;
+      pisa->vals = ISStr::intern(symbol);
       return;
     }
     if (is_quote(symbol)) {
@@ -608,29 +1688,131 @@ class IndraScheme {
     }
     bool showParse = false;
     if (showParse) {
-      vector<map<string, ISAtom *>> ls = {};
+      ISScopes ls = {};
       if (pStart) {
         cout << "Parse: (" << level << ") ";
         print(pStart, ls, ISAtom::DecorType::UNICODE, true);
         cout << endl;
       }
     }
+    if (constPooling && level == 0) hashCons(pStart);
     return pStart;
   }
 
-  void print(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols, ISAtom::DecorType decor, bool bAutoSeparators) {
+  // Optional hash-consing of parsed literals: identical quoted lists share one
+  // unregistered copy held in constPool, identical string literals share one
+  // buffer. Pooled constants live until const_pool_clear().
+  bool constPooling = false;
+  std::unordered_multimap<size_t, ISAtom *> constPool;
+  std::unordered_map<string, ISStr> constStrings;
+
+  size_t literalHash(const ISAtom *pisa) {
+    size_t h = 0;
+    for (const ISAtom *p = pisa; p; p = p->pNext) {
+      size_t hi = p->t;
+      switch (p->t) {
+      case ISAtom::TokType::INT:
+      case ISAtom::TokType::BOOLEAN:
+        hi ^= std::hash<int>()(p->val) << 4;
+        break;
+      case ISAtom::TokType::FLOAT:
+        hi ^= std::hash<double>()(p->valf) << 4;
+        break;
+      case ISAtom::TokType::STRING:
+      case ISAtom::TokType::SYMBOL:
+      case ISAtom::TokType::ERROR:
+        hi ^= std::hash<string>()(p->vals) << 4;
+        break;
+      default:
+        break;
+      }
+      if (p->pChild) hi ^= literalHash(p->pChild) * 131;
+      h = h * 1000003 ^ hi;
+    }
+    return h;
+  }
+
+  bool literalEqual(const ISAtom *pa, const ISAtom *pb) {
+    for (; pa && pb; pa = pa->pNext, pb = pb->pNext) {
+      if (pa == pb) return true;
+      if (pa->t != pb->t) return false;
+      switch (pa->t) {
+      case ISAtom::TokType::INT:
+      case ISAtom::TokType::BOOLEAN:
+        if (pa->val != pb->val) return false;
+        break;
+      case ISAtom::TokType::FLOAT:
+        if (pa->valf != pb->valf) return false;
+        break;
+      case ISAtom::TokType::STRING:
+      case ISAtom::TokType::SYMBOL:
+      case ISAtom::TokType::ERROR:
+        if (pa->vals != pb->vals) return false;
+        break;
+      default:
+        break;
+      }
+      if (!literalEqual(pa->pChild, pb->pChild)) return false;
+    }
+    return pa == pb;
+  }
+
+  ISAtom *poolLiteral(const ISAtom *pisa) {  // new reference to the pooled equivalent of a list body
+    size_t h = literalHash(pisa);
+    auto range = constPool.equal_range(h);
+    for (auto pos = range.first; pos != range.second; ++pos) {
+      if (literalEqual(pos->second, pisa)) return shareList(pos->second);
+    }
+    ISAtom *pC = copyList(pisa, false);
+    constPool.insert({h, pC});
+    return shareList(pC);
+  }
+
+  void hashCons(ISAtom *pisa) {
+    bool is_quote = false;
+    for (ISAtom *p = pisa; p; p = p->pNext) {
+      if (p->t == ISAtom::TokType::STRING) {
+        auto pos = constStrings.find(p->vals);
+        if (pos != constStrings.end())
+          p->vals = pos->second;
+        else
+          constStrings[p->vals] = p->vals;
+      }
+      if (p->t == ISAtom::TokType::LIST && p->pChild) {
+        hashCons(p->pChild);
+        if (is_quote) {
+          ISAtom *pC = poolLiteral(p->pChild);
+          deleteList(p->pChild, "hashCons");
+          p->pChild = pC;
+        }
+      }
+      is_quote = p->t == ISAtom::TokType::QUOTE;
+    }
+  }
+
+  void const_pool_clear() {
+    for (auto cp : constPool)
+      deleteList(cp.second, "const_pool_clear");
+    constPool.clear();
+    constStrings.clear();
+  }
+
+  void print(const ISAtom *pisa, ISScopes &local_symbols, ISAtom::DecorType decor, bool bAutoSeparators) {
     if (!pisa) {
       cout << "NULLPTR!";
       return;
     }
     string out = pisa->str(decor);
     ISAtom *pN = pisa->pNext;
-    if (decor) {
-      if (is_inbuilt(pisa->vals) || is_defined_func(pisa->vals)) out = "⒡ " + out;
-      if (is_defined_symbol(pisa->vals, local_symbols)) out = "⒮ " + out;
+    if (decor && pisa->t == ISAtom::TokType::SYMBOL) {
+      int id = pisa->vals.symId();
+      if (is_inbuilt(id) || is_defined_func(id)) out = "⒡ " + out;
+      if (is_defined_symbol(id, local_symbols)) out = "⒮ " + out;
     }
     cout << out;
-    if (pisa->pChild != nullptr) {
+    if (pisa->t == ISAtom::TokType::CLOSURE) {
+      print(pisa->pChild->pChild, local_symbols, decor, bAutoSeparators);  // the lambda, without the environment
+    } else if (pisa->pChild != nullptr) {
       print(pisa->pChild, local_symbols, decor, bAutoSeparators);
       cout << ")";
     }
@@ -654,16 +1836,19 @@ class IndraScheme {
     return s;
   }
 
-  string stringify(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols, ISAtom::DecorType decor, bool bAutoSeparators, int tab_size = 0, int level = 0) {
+  string stringify(const ISAtom *pisa, ISScopes &local_symbols, ISAtom::DecorType decor, bool bAutoSeparators, int tab_size = 0, int level = 0) {
     string out = pisa->str(decor);
     ISAtom *pN = pisa->pNext;
-    if (decor) {
-      if (is_inbuilt(pisa->vals) || is_defined_func(pisa->vals))
+    if (decor && pisa->t == ISAtom::TokType::SYMBOL) {
+      int id = pisa->vals.symId();
+      if (is_inbuilt(id) || is_defined_func(id))
         out = "ⓕ " + out;
-      else if (is_defined_symbol(pisa->vals, local_symbols))
+      else if (is_defined_symbol(id, local_symbols))
         out = "ⓢ " + out;
     }
-    if (pisa->pChild != nullptr) {
+    if (pisa->t == ISAtom::TokType::CLOSURE) {
+      out += stringify(pisa->pChild->pChild, local_symbols, decor, bAutoSeparators, tab_size, level);
+    } else if (pisa->pChild != nullptr) {
       out += stringify(pisa->pChild, local_symbols, decor, bAutoSeparators, tab_size, level + 1);
       if (out.length() > 0 && out[out.length() - 1] == ' ') {
         out[out.length() - 1] = ')';
@@ -681,180 +1866,300 @@ class IndraScheme {
     return out;
   }
 
-  ISAtom *cmp_2ops(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols, string m_op) {
-    const ISAtom *p = pisa, *pn = nullptr;
-    ISAtom *pRes = gca();
-    vector<const ISAtom *> pAllocs;
+  enum MathOp { MATH_ADD,
+                MATH_SUB,
+                MATH_MUL,
+                MATH_DIV,
+                MATH_MOD };
+  enum CmpOp { CMP_EQ,
+               CMP_NE,
+               CMP_GE,
+               CMP_LE,
+               CMP_LT,
+               CMP_GT,
+               CMP_AND,
+               CMP_OR };
+
+  static const string &math_op_name(int m_op) {
+    static const string names[] = {"+", "-", "*", "/", "%"};
+    return names[m_op];
+  }
 
-    if (getListLen(pisa) != 2) {
-      pRes->t = ISAtom::TokType::ERROR;
-      pRes->vals = "Two operands required for <" + m_op + "> operation";
+  static const string &cmp_op_name(int m_op) {
+    static const string names[] = {"==", "!=", ">=", "<=", "<", ">", "and", "or"};
+    return names[m_op];
+  }
+
+  template <int m_op>
+  ISAtom *math_op(const ISAtom *pisa, ISScopes &local_symbols) {
+    if (!isTwoOperands(pisa)) return math_2ops(pisa, local_symbols, m_op);
+    const ISAtom *pb = pisa->pNext;
+    // Two operands: evaluate them one by one and try the kernel before building an operand chain.
+    if (gcpool.overBudget) return heapError();
+    bool bOwnedA, bOwnedB;
+    ISAtom *pa = evalOperand(pisa, local_symbols, bOwnedA);
+    if (pa && pa->t == ISAtom::TokType::ERROR) return math_kernel(bOwnedA ? pa : copyAtom(pa), m_op);
+    if (gcpool.overBudget) {
+      if (bOwnedA) deleteList(pa, "math_op over budget");
+      return heapError();
+    }
+    ISAtom *pb_ev = evalOperand(pb, local_symbols, bOwnedB);
+    ISAtom *pRes = nullptr;
+    if (pa && pb_ev && (!bOwnedA || !pa->pNext) && (!bOwnedB || !pb_ev->pNext)) pRes = math_fast<m_op>(pa, pb_ev);
+    if (pRes) {
+      if (bOwnedA) deleteList(pa, "math_op");
+      if (bOwnedB) deleteList(pb_ev, "math_op");
       return pRes;
     }
-    ISAtom *pev = chainEval(pisa, local_symbols, true);
-    pAllocs.push_back(pev);
-    if (getListLen(pev) != 2) {
-      pRes->t = ISAtom::TokType::ERROR;
-      pRes->vals = "Two operands required for <" + m_op + "> operation";
-      deleteList(pev, "cmp_2ops parcheck");
-      return pRes;
+    if (pb_ev && pb_ev->t == ISAtom::TokType::ERROR) {
+      if (bOwnedA) deleteList(pa, "math_op error");
+      return math_kernel(bOwnedB ? pb_ev : copyAtom(pb_ev), m_op);
     }
+    return math_kernel(operandChain(pa, bOwnedA, pb_ev, bOwnedB), m_op);
+  }
 
-    ISAtom *pl = copyAtom(pev);
-    pAllocs.push_back(pl);
-
-    ISAtom *pr = copyAtom(pev->pNext);
-    pAllocs.push_back(pr);
-
-    if (pl->t != pr->t) {
-      pRes->t = ISAtom::TokType::ERROR;
-      pRes->vals = "Error: compare " + m_op + " requires two operands of same type, got: " + tokTypeNames[pl->t] + " and " + tokTypeNames[pr->t];
-      for (const ISAtom *p : pAllocs) {
-        deleteList((ISAtom *)p, "cmp_2ops 1");
-      }
-      return pRes;
-    }
-    pRes->t = ISAtom::TokType::BOOLEAN;
-    pRes->val = 0;
-    bool a, b, r;
-    switch (pl->t) {
-    case ISAtom::TokType::INT:
-      if (m_op == "==")
-        r = (pl->val == pr->val);
-      else if (m_op == ">=")
-        r = (pl->val >= pr->val);
-      else if (m_op == "<=")
-        r = (pl->val <= pr->val);
-      else if (m_op == "!=")
-        r = (pl->val != pr->val);
-      else if (m_op == ">")
-        r = (pl->val > pr->val);
-      else if (m_op == "<")
-        r = (pl->val < pr->val);
-      else {
+  // INT/INT and FLOAT/FLOAT arithmetic on two values (their pNext is ignored),
+  // allocating only the result. nullptr: other types, leave it to math_kernel().
+  template <int m_op>
+  ISAtom *math_fast(const ISAtom *pa, const ISAtom *pb) {
+    if (pa->t != pb->t) return nullptr;
+    ISAtom *pRes = nullptr;
+    if (pa->t == ISAtom::TokType::INT) {
+      pRes = gca();
+      if ((m_op == MATH_DIV || m_op == MATH_MOD) && pb->val == 0) {
         pRes->t = ISAtom::TokType::ERROR;
-        pRes->vals = "Unsupported compare operation: " + m_op + " for type " + tokTypeNames[pl->t];
-        for (const ISAtom *p : pAllocs) {
-          deleteList((ISAtom *)p, "cmp_2ops 2");
-        }
+        pRes->vals = "DIV/ZERO!";
         return pRes;
       }
-      if (r)
-        pRes->val = 1;
-      else
-        pRes->val = 0;
-      for (const ISAtom *p : pAllocs) {
-        deleteList((ISAtom *)p, "cmp_2ops 3");
+      pRes->t = ISAtom::TokType::INT;
+      switch (m_op) {
+      case MATH_ADD:
+        pRes->val = pa->val + pb->val;
+        break;
+      case MATH_SUB:
+        pRes->val = pa->val - pb->val;
+        break;
+      case MATH_MUL:
+        pRes->val = pa->val * pb->val;
+        break;
+      case MATH_DIV:
+        pRes->val = pa->val / pb->val;
+        break;
+      case MATH_MOD:
+        pRes->val = pa->val % pb->val;
+        break;
       }
       return pRes;
-      break;
-    case ISAtom::TokType::FLOAT:
-      if (m_op == "==")
-        r = (pl->valf == pr->valf);
-      else if (m_op == ">=")
-        r = (pl->valf >= pr->valf);
-      else if (m_op == "<=")
-        r = (pl->valf <= pr->valf);
-      else if (m_op == "!=")
-        r = (pl->valf != pr->valf);
-      else if (m_op == ">")
-        r = (pl->valf > pr->valf);
-      else if (m_op == "<")
-        r = (pl->valf < pr->valf);
-      else {
+    }
+    if (pa->t == ISAtom::TokType::FLOAT && m_op != MATH_MOD) {
+      pRes = gca();
+      if (m_op == MATH_DIV && pb->valf == 0) {
         pRes->t = ISAtom::TokType::ERROR;
-        pRes->vals = "Unsupported compare operation: " + m_op + " for type " + tokTypeNames[pl->t];
-        for (const ISAtom *p : pAllocs) {
-          deleteList((ISAtom *)p, "cmp_2ops 4");
-        }
+        pRes->vals = "DIV/ZERO!";
         return pRes;
       }
-      if (r)
-        pRes->val = 1;
-      else
-        pRes->val = 0;
-      for (const ISAtom *p : pAllocs) {
-        deleteList((ISAtom *)p, "cmp_2ops 5");
+      pRes->t = ISAtom::TokType::FLOAT;
+      switch (m_op) {
+      case MATH_ADD:
+        pRes->valf = pa->valf + pb->valf;
+        break;
+      case MATH_SUB:
+        pRes->valf = pa->valf - pb->valf;
+        break;
+      case MATH_MUL:
+        pRes->valf = pa->valf * pb->valf;
+        break;
+      case MATH_DIV:
+        pRes->valf = pa->valf / pb->valf;
+        break;
       }
       return pRes;
-      break;
+    }
+    return pRes;
+  }
+
+  ISAtom *math_fast(const ISAtom *pa, const ISAtom *pb, int m_op) {
+    switch (m_op) {
+    case MATH_ADD:
+      return math_fast<MATH_ADD>(pa, pb);
+    case MATH_SUB:
+      return math_fast<MATH_SUB>(pa, pb);
+    case MATH_MUL:
+      return math_fast<MATH_MUL>(pa, pb);
+    case MATH_DIV:
+      return math_fast<MATH_DIV>(pa, pb);
+    case MATH_MOD:
+      return math_fast<MATH_MOD>(pa, pb);
+    }
+    return nullptr;
+  }
+
+  static bool isTwoOperands(const ISAtom *pisa) {  // exactly two plain operands, no quotes
+    const ISAtom *pb = pisa ? pisa->pNext : nullptr;
+    if (!pb || pisa->t == ISAtom::TokType::QUOTE || pisa->t == ISAtom::TokType::NIL || pb->t == ISAtom::TokType::QUOTE || pb->t == ISAtom::TokType::NIL) return false;
+    return !pb->pNext || pb->pNext->t == ISAtom::TokType::NIL;
+  }
+
+  ISAtom *operandChain(ISAtom *pa, bool bOwnedA, ISAtom *pb, bool bOwnedB) {  // owned chain of two evaluated operands, as chainEval() links it
+    if (pa && !bOwnedA) pa = copyAtom(pa);
+    if (pb && !bOwnedB) pb = copyAtom(pb);
+    pa = ownHead(pa);
+    pb = ownHead(pb);
+    if (!pa) return pb ? pb : gca();
+    pa->pNext = pb;
+    return pa;
+  }
+
+  // A single operand, evaluated as chainEval() would. Literals are returned
+  // in place (bOwned false) instead of being copied.
+  ISAtom *evalOperand(const ISAtom *p, ISScopes &local_symbols, bool &bOwned) {
+    bOwned = true;
+    switch (p->t) {
     case ISAtom::TokType::SYMBOL:
-    case ISAtom::TokType::STRING:
-      if (m_op == "==")
-        r = (pl->vals == pr->vals);
-      else if (m_op == ">=")
-        r = (pl->vals >= pr->vals);
-      else if (m_op == "<=")
-        r = (pl->vals <= pr->vals);
-      else if (m_op == "!=")
-        r = (pl->vals != pr->vals);
-      else if (m_op == ">")
-        r = (pl->vals > pr->vals);
-      else if (m_op == "<")
-        r = (pl->vals < pr->vals);
-      else {
-        pRes->t = ISAtom::TokType::ERROR;
-        pRes->vals = "Unsupported compare operation: " + m_op + " for type " + tokTypeNames[pl->t];
-        for (const ISAtom *p : pAllocs) {
-          deleteList((ISAtom *)p, "cmp_2ops 6");
-        }
-        return pRes;
-      }
-      if (r)
-        pRes->val = 1;
-      else
-        pRes->val = 0;
-      for (const ISAtom *p : pAllocs) {
-        deleteList((ISAtom *)p, "cmp_2ops 7");
-      }
+      return eval_symbol(p, local_symbols);
+    case ISAtom::TokType::LIST:
+      if (p->pChild->pChild) return eval(p->pChild, local_symbols, true, true);
+      return eval(p->pChild, local_symbols, true);
+    default:
+      bOwned = false;
+      return (ISAtom *)p;
+    }
+  }
+
+  template <int m_op>
+  ISAtom *cmp_op(const ISAtom *pisa, ISScopes &local_symbols) {
+    if (!isTwoOperands(pisa)) return cmp_2ops(pisa, local_symbols, m_op);
+    // Operands are compared where they are: literals in the tree, values as evaluated.
+    if (gcpool.overBudget) return heapError();
+    bool bOwnedL, bOwnedR;
+    ISAtom *pl = evalOperand(pisa, local_symbols, bOwnedL);
+    if (pl && pl->t == ISAtom::TokType::ERROR) return cmp_kernel(bOwnedL ? pl : copyAtom(pl), m_op);
+    if (gcpool.overBudget) {
+      if (bOwnedL) deleteList(pl, "cmp_op over budget");
+      return heapError();
+    }
+    ISAtom *pr = evalOperand(pisa->pNext, local_symbols, bOwnedR);
+    if (pl && pr && pr->t != ISAtom::TokType::ERROR && (!bOwnedL || !pl->pNext) && (!bOwnedR || !pr->pNext)) {
+      ISAtom *pRes = cmp_result(pl, pr, m_op);
+      if (bOwnedL) deleteList(pl, "cmp_op");
+      if (bOwnedR) deleteList(pr, "cmp_op");
       return pRes;
-      break;
-    case ISAtom::TokType::BOOLEAN:
-      if (pl->val)
-        a = true;
-      else
-        a = false;
-      if (pr->val)
-        b = true;
-      else
-        b = false;
-      if (m_op == "==")
-        r = (a == b);
-      else if (m_op == "and")
-        r = (a && b);
-      else if (m_op == "or")
-        r = (a || b);
-      else if (m_op == "!=")
-        r = (a != b);
-      else {
-        pRes->t = ISAtom::TokType::ERROR;
-        pRes->vals = "Unsupported compare operation: " + m_op + " for type " + tokTypeNames[pl->t];
-        for (const ISAtom *p : pAllocs) {
-          deleteList((ISAtom *)p, "cmp_2ops 8");
-        }
-        return pRes;
+    }
+    if (pr && pr->t == ISAtom::TokType::ERROR) {
+      if (bOwnedL) deleteList(pl, "cmp_op error");
+      return cmp_kernel(bOwnedR ? pr : copyAtom(pr), m_op);
+    }
+    return cmp_kernel(operandChain(pl, bOwnedL, pr, bOwnedR), m_op);
+  }
+
+  ISAtom *cmp_2ops(const ISAtom *pisa, ISScopes &local_symbols, int m_op) {
+    if (getListLen(pisa) != 2) {
+      ISAtom *pRes = gca();
+      pRes->t = ISAtom::TokType::ERROR;
+      pRes->vals = "Two operands required for <" + cmp_op_name(m_op) + "> operation";
+      return pRes;
+    }
+    return cmp_kernel(chainEval(pisa, local_symbols, true), m_op);
+  }
+
+  ISAtom *cmp_kernel(ISAtom *pOperands, int m_op) {  // consumes the evaluated operand chain
+    size_t nmark = nursery_mark();
+    ISAtom *pev = nursery_add(pOperands);
+    ISAtom *pRes = cmp_result(pev, getListLen(pev) == 2 ? pev->pNext : nullptr, m_op);
+    nursery_release(nmark);
+    return pRes;
+  }
+
+  // Comparisons answer with a new reference to one of the interpreter's
+  // #t/#f atoms, only errors are allocated. pr nullptr: wrong operand count.
+  ISAtom *cmp_result(const ISAtom *pl, const ISAtom *pr, int m_op) {
+    string msg;
+    if (!pr)
+      msg = "Two operands required for <" + cmp_op_name(m_op) + "> operation";
+    else if (pl->t != pr->t)
+      msg = "Error: compare " + cmp_op_name(m_op) + " requires two operands of same type, got: " + tokTypeNames[pl->t] + " and " + tokTypeNames[pr->t];
+    else {
+      switch (cmp_values(pl, pr, m_op)) {
+      case 1:
+        return shareList(pTrue);
+      case 0:
+        return shareList(pFalse);
+      case -1:
+        msg = "Unsupported compare operation: " + cmp_op_name(m_op) + " for type " + tokTypeNames[pl->t];
+        break;
+      default:
+        msg = "Can't compare " + cmp_op_name(m_op) + " for type: " + tokTypeNames[pl->t];
+        break;
       }
-      if (r)
-        pRes->val = 1;
-      else
-        pRes->val = 0;
-      for (const ISAtom *p : pAllocs) {
-        deleteList((ISAtom *)p, "cmp_2ops 9");
+    }
+    ISAtom *pRes = gca();
+    pRes->t = ISAtom::TokType::ERROR;
+    pRes->vals = msg;
+    return pRes;
+  }
+
+  // 1/0 for two values of the same type, -1: operator not defined for the
+  // type, -2: type not comparable.
+  static int cmp_values(const ISAtom *pl, const ISAtom *pr, int m_op) {
+    switch (pl->t) {
+    case ISAtom::TokType::INT:
+      return cmp_ordered(pl->val, pr->val, m_op);
+    case ISAtom::TokType::FLOAT:
+      return cmp_ordered(pl->valf, pr->valf, m_op);
+    case ISAtom::TokType::SYMBOL:
+    case ISAtom::TokType::STRING:
+      return cmp_ordered(pl->vals, pr->vals, m_op);
+    case ISAtom::TokType::BOOLEAN: {
+      bool a = pl->val != 0, b = pr->val != 0;
+      switch (m_op) {
+      case CMP_EQ:
+        return a == b;
+      case CMP_NE:
+        return a != b;
+      case CMP_AND:
+        return a && b;
+      case CMP_OR:
+        return a || b;
+      default:
+        return -1;
       }
-      return pRes;
-      break;
+    }
+    default:
+      return -2;
+    }
+  }
+
+  template <class T>
+  static int cmp_ordered(const T &a, const T &b, int m_op) {
+    switch (m_op) {
+    case CMP_EQ:
+      return a == b;
+    case CMP_NE:
+      return a != b;
+    case CMP_GE:
+      return a >= b;
+    case CMP_LE:
+      return a <= b;
+    case CMP_LT:
+      return a < b;
+    case CMP_GT:
+      return a > b;
     default:
+      return -1;
+    }
+  }
+
+  ISAtom *math_2ops(const ISAtom *pisa, ISScopes &local_symbols, int m_op) {
+    if (getListLen(pisa) < 2) {
+      ISAtom *pRes = gca();
       pRes->t = ISAtom::TokType::ERROR;
-      pRes->vals = "Can't compare " + m_op + " for type: " + tokTypeNames[pl->t];
-      for (const ISAtom *p : pAllocs) {
-        deleteList((ISAtom *)p, "cmp_2ops 10");
-      }
+      pRes->vals = "Not enough operands for <" + math_op_name(m_op) + "> operation";
       return pRes;
     }
+    return math_kernel(chainEval(pisa, local_symbols, true), m_op);
   }
 
-  ISAtom *math_2ops(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols, string m_op) {
-    // ISAtom *pisa = copyList(pisa_o);
+  ISAtom *math_kernel(ISAtom *pOperands, int m_op) {  // consumes the evaluated operand chain
     int res = 0;
     double fres = 0.0;
     string sres = "";
@@ -863,16 +2168,9 @@ class IndraScheme {
     ISAtom::TokType dt = ISAtom::TokType::NIL;
     bool first = true;
     ISAtom *pRes = gca();
-    vector<ISAtom *> pAllocs;
-
-    if (getListLen(pisa) < 2) {
-      pRes->t = ISAtom::TokType::ERROR;
-      pRes->vals = "Not enough operands for <" + m_op + "> operation";
-      return pRes;
-    }
-    ISAtom *pev = chainEval(pisa, local_symbols, true);
-    pAllocs.push_back(pev);
-    ISAtom *p = (ISAtom *)pev;
+    size_t nmark = nursery_mark();
+    ISAtom *pev = nursery_add(pOperands);
+    ISAtom *p = pev;
     while (p != nullptr) {
       switch (p->t) {
       case ISAtom::TokType::INT:
@@ -881,7 +2179,7 @@ class IndraScheme {
           dt = ISAtom::TokType::INT;
           first = false;
         } else {
-          if (m_op == "+") {
+          if (m_op == MATH_ADD) {
             switch (dt) {
             case ISAtom::TokType::INT:
               res += p->val;
@@ -895,13 +2193,11 @@ class IndraScheme {
             default:
               pRes->t = ISAtom::TokType::ERROR;
               pRes->vals = "Unsupported operand-type for '+': " + tokTypeNames[dt];
-              for (auto p : pAllocs) {
-                deleteList(p, "math_2ops +1");
-              }
+              nursery_release(nmark);
               return pRes;
               break;
             }
-          } else if (m_op == "-") {
+          } else if (m_op == MATH_SUB) {
             switch (dt) {
             case ISAtom::TokType::INT:
               res -= p->val;
@@ -912,13 +2208,11 @@ class IndraScheme {
             default:
               pRes->t = ISAtom::TokType::ERROR;
               pRes->vals = "Unsupported operand-type for '-': " + tokTypeNames[dt];
-              for (auto p : pAllocs) {
-                deleteList(p, "math_2ops -1");
-              }
+              nursery_release(nmark);
               return pRes;
               break;
             }
-          } else if (m_op == "*") {
+          } else if (m_op == MATH_MUL) {
             string smult = "";
             switch (dt) {
             case ISAtom::TokType::INT:
@@ -935,19 +2229,15 @@ class IndraScheme {
             default:
               pRes->t = ISAtom::TokType::ERROR;
               pRes->vals = "Unsupported operand-type for '*': " + tokTypeNames[dt];
-              for (auto p : pAllocs) {
-                deleteList(p, "math_2ops *1");
-              }
+              nursery_release(nmark);
               return pRes;
               break;
             }
-          } else if (m_op == "/") {
+          } else if (m_op == MATH_DIV) {
             if (p->val == 0) {
               pRes->t = ISAtom::TokType::ERROR;
               pRes->vals = "DIV/ZERO!";
-              for (auto p : pAllocs) {
-                deleteList(p, "math_2ops /1-0");
-              }
+              nursery_release(nmark);
               return pRes;
             } else {
               switch (dt) {
@@ -960,20 +2250,16 @@ class IndraScheme {
               default:
                 pRes->t = ISAtom::TokType::ERROR;
                 pRes->vals = "Unsupported operand-type for '/': " + tokTypeNames[dt];
-                for (auto p : pAllocs) {
-                  deleteList(p, "math_2ops /1");
-                }
+                nursery_release(nmark);
                 return pRes;
                 break;
               }
             }
-          } else if (m_op == "%") {
+          } else if (m_op == MATH_MOD) {
             if (p->val == 0) {
               pRes->t = ISAtom::TokType::ERROR;
               pRes->vals = "DIV/ZERO!";
-              for (auto p : pAllocs) {
-                deleteList(p, "math_ops %1-0");
-              }
+              nursery_release(nmark);
               return pRes;
             } else {
               switch (dt) {
@@ -986,19 +2272,15 @@ class IndraScheme {
               default:
                 pRes->t = ISAtom::TokType::ERROR;
                 pRes->vals = "Unsupported operand-type for '%': " + tokTypeNames[dt];
-                for (auto p : pAllocs) {
-                  deleteList(p, "math_2ops %1");
-                }
+                nursery_release(nmark);
                 return pRes;
                 break;
               }
             }
           } else {
             pRes->t = ISAtom::TokType::ERROR;
-            pRes->vals = "Op-not-impl: " + m_op;
-            for (auto p : pAllocs) {
-              deleteList(p, "math_ops 3");
-            }
+            pRes->vals = "Op-not-impl: " + math_op_name(m_op);
+            nursery_release(nmark);
             return pRes;
           }
         }
@@ -1009,7 +2291,7 @@ class IndraScheme {
           first = false;
           dt = ISAtom::TokType::FLOAT;
         } else {
-          if (m_op == "+") {
+          if (m_op == MATH_ADD) {
             switch (dt) {
             case ISAtom::TokType::INT:
               fres = res + p->valf;
@@ -1024,13 +2306,11 @@ class IndraScheme {
             default:
               pRes->t = ISAtom::TokType::ERROR;
               pRes->vals = "Unsupported operand-type for '+': " + tokTypeNames[dt];
-              for (auto p : pAllocs) {
-                deleteList(p, "math_2ops +2");
-              }
+              nursery_release(nmark);
               return pRes;
               break;
             }
-          } else if (m_op == "-") {
+          } else if (m_op == MATH_SUB) {
             switch (dt) {
             case ISAtom::TokType::INT:
               fres = res - p->valf;
@@ -1042,13 +2322,11 @@ class IndraScheme {
             default:
               pRes->t = ISAtom::TokType::ERROR;
               pRes->vals = "Unsupported operand-type for '-': " + tokTypeNames[dt];
-              for (auto p : pAllocs) {
-                deleteList(p, "math_2ops -2");
-              }
+              nursery_release(nmark);
               return pRes;
               break;
             }
-          } else if (m_op == "*") {
+          } else if (m_op == MATH_MUL) {
             switch (dt) {
             case ISAtom::TokType::INT:
               fres = res * p->valf;
@@ -1060,19 +2338,15 @@ class IndraScheme {
             default:
               pRes->t = ISAtom::TokType::ERROR;
               pRes->vals = "Unsupported operand-type for '*': " + tokTypeNames[dt];
-              for (auto p : pAllocs) {
-                deleteList(p, "math_2ops *2");
-              }
+              nursery_release(nmark);
               return pRes;
               break;
             }
-          } else if (m_op == "/") {
+          } else if (m_op == MATH_DIV) {
             if (p->valf == 0) {
               pRes->t = ISAtom::TokType::ERROR;
               pRes->vals = "DIV/ZERO!";
-              for (auto p : pAllocs) {
-                deleteList(p, "math_ops /2-0");
-              }
+              nursery_release(nmark);
               return pRes;
             } else {
               switch (dt) {
@@ -1086,20 +2360,16 @@ class IndraScheme {
               default:
                 pRes->t = ISAtom::TokType::ERROR;
                 pRes->vals = "Unsupported operand-type for '/': " + tokTypeNames[dt];
-                for (auto p : pAllocs) {
-                  deleteList(p, "math_2ops /2");
-                }
+                nursery_release(nmark);
                 return pRes;
                 break;
               }
             }
-          } else if (m_op == "%") {
+          } else if (m_op == MATH_MOD) {
             if (p->valf == 0) {
               pRes->t = ISAtom::TokType::ERROR;
               pRes->vals = "DIV/ZERO!";
-              for (auto p : pAllocs) {
-                deleteList(p, "math_ops %2-0");
-              }
+              nursery_release(nmark);
               return pRes;
             } else {
               switch (dt) {
@@ -1113,19 +2383,15 @@ class IndraScheme {
               default:
                 pRes->t = ISAtom::TokType::ERROR;
                 pRes->vals = "Unsupported operand-type for '%': " + tokTypeNames[dt];
-                for (auto p : pAllocs) {
-                  deleteList(p, "math_2ops %2");
-                }
+                nursery_release(nmark);
                 return pRes;
                 break;
               }
             }
           } else {
             pRes->t = ISAtom::TokType::ERROR;
-            pRes->vals = "Op-not-impl: " + m_op;
-            for (auto p : pAllocs) {
-              deleteList(p, "math_ops 6");
-            }
+            pRes->vals = "Op-not-impl: " + math_op_name(m_op);
+            nursery_release(nmark);
             return pRes;
           }
         }
@@ -1136,7 +2402,7 @@ class IndraScheme {
           first = false;
           dt = ISAtom::TokType::STRING;
         } else {
-          if (m_op == "+") {
+          if (m_op == MATH_ADD) {
             switch (dt) {
             case ISAtom::TokType::STRING:
               sres = sres + p->vals;
@@ -1144,9 +2410,7 @@ class IndraScheme {
             default:
               pRes->t = ISAtom::TokType::ERROR;
               pRes->vals = "Unsupported operand-type for 'String-+': " + tokTypeNames[dt];
-              for (auto p : pAllocs) {
-                deleteList(p, "math_2ops %2");
-              }
+              nursery_release(nmark);
               return pRes;
               break;
             }
@@ -1158,14 +2422,12 @@ class IndraScheme {
         break;
       default:
         pRes->t = ISAtom::TokType::ERROR;
-        pRes->vals = "Op: " + m_op;
+        pRes->vals = "Op: " + math_op_name(m_op);
         if (p) {
-          cout << "Type: " << p->t << endl;
+          cout << "Type: " << (int)p->t << endl;
           pRes->vals += ", unhandled tokType: " + tokTypeNames[p->t] + " -> " + p->str();
           if (p->t == ISAtom::TokType::ERROR) pRes->vals += ": " + p->vals;
-          for (auto p : pAllocs) {
-            deleteList(p, "math_2ops +1");
-          }
+          nursery_release(nmark);
         } else {
           pRes->vals += " nullptr argument";
         }
@@ -1192,81 +2454,72 @@ class IndraScheme {
       pRes->vals = "Data type not implemented as math result: " + tokTypeNames[dt];
       break;
     }
-    for (auto p : pAllocs) {
-      deleteList(p, "math_ops 7");
-    }
+    nursery_release(nmark);
     return pRes;
   }
 
   bool
-  is_defined(string name, vector<map<string, ISAtom *>> &local_symbols) {
-    if (symbols.find(name) == symbols.end() && funcs.find(name) == funcs.end() && is_defined_local_symbol(name, local_symbols) == false) return false;
-    return true;
+  is_defined(int id, ISScopes &local_symbols) {
+    return symbols.contains(id) || funcs.contains(id) || is_defined_local_symbol(id, local_symbols);
   }
 
-  bool is_defined_local_symbol(const string &token, const vector<map<string, ISAtom *>> &local_symbols) {
+  bool is_defined_local_symbol(int id, const ISScopes &local_symbols) {
     size_t len = local_symbols.size();
     for (int in = (int)len - 1; in >= 0; in--) {
-      if (local_symbols[in].find(token) != local_symbols[in].end()) return true;
+      if (local_symbols[in].find(id) != local_symbols[in].end()) return true;
     }
     return false;
   }
 
-  ISAtom *get_local_symbol(const string &token, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *get_local_symbol(int id, ISScopes &local_symbols) {
     size_t len = local_symbols.size();
     for (int in = (int)len - 1; in >= 0; in--) {
-      if (local_symbols[in].find(token) != local_symbols[in].end()) {
-        return copyList(local_symbols[in][token]);
+      auto pos = local_symbols[in].find(id);
+      if (pos != local_symbols[in].end()) {
+        return shareList(pos->second);
       }
     }
     return nullptr;
   }
 
-  void set_local_symbol(const string &token, ISAtom *val, vector<map<string, ISAtom *>> &local_symbols) {
+  void set_local_symbol(int id, ISAtom *val, ISScopes &local_symbols) {
     size_t len = local_symbols.size();
     if (len == 0) {
       cout << "can't define local variable without local stack!" << endl;
       return;
     }
-    for (int in = (int)len - 1; in >= 0; in--) {
-      if (local_symbols[in].find(token) != local_symbols[in].end()) {
-        deleteList(local_symbols[in][token], "set_local_sym");
-        local_symbols[in][token] = val;
-        return;
-      }
-      break;
+    auto pos = local_symbols[len - 1].find(id);
+    if (pos != local_symbols[len - 1].end()) {
+      deleteList(pos->second, "set_local_sym");
+      pos->second = val;
+      return;
     }
-    local_symbols[len - 1][token] = val;
+    local_symbols[len - 1][id] = val;
   }
 
-  void pop_local_symbols(vector<map<string, ISAtom *>> &local_symbols) {
+  void pop_local_symbols(ISScopes &local_symbols) {
     size_t len = local_symbols.size();
     if (len > 0) {
-      int n = 0;
       for (auto p : local_symbols[len - 1]) {
-        deleteList(p.second, "pop_local_sym_" + std::to_string(n) + " " + p.first);
-        ++n;
+        deleteList(p.second, "pop_local_sym");
       }
       local_symbols.pop_back();
     }
   }
 
-  bool is_defined_symbol(const string name, vector<map<string, ISAtom *>> &local_symbols) {
-    if (symbols.find(name) == symbols.end() && is_defined_local_symbol(name, local_symbols) == false) return false;
-    return true;
+  bool is_defined_symbol(int id, ISScopes &local_symbols) {
+    return symbols.contains(id) || is_defined_local_symbol(id, local_symbols);
   }
 
-  bool is_defined_global_symbol(const string name) {
-    if (symbols.find(name) == symbols.end()) return false;
-    return true;
+  bool is_defined_global_symbol(int id) {
+    return symbols.contains(id);
   }
 
-  bool is_defined_func(string name) {
-    if (funcs.find(name) == funcs.end()) return false;
-    return true;
+  bool is_defined_func(int id) {
+    return funcs.contains(id);
   }
 
-  ISAtom *makeDefine(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *makeDefine(const ISAtom *pisa, ISScopes &local_symbols) {
     // ISAtom *pisa = copyList(pisa_o);
     ISAtom *pRes = gca();
     if (getListLen(pisa) != 2) {
@@ -1277,7 +2530,7 @@ class IndraScheme {
     const ISAtom *pN = pisa;
     ISAtom *pV = pN->pNext;
     ISAtom *pNa;
-    int n = 0;
+    int n = 0, id;
     bool err = false;
     switch (pN->t) {
     case ISAtom::TokType::SYMBOL:
@@ -1286,17 +2539,19 @@ class IndraScheme {
         pRes->vals = "Symbol-'define' requires exactly 2 operands: name and value";
         return pRes;
       }
+      id = pN->vals.symId();
       if (pV->t == ISAtom::TokType::QUOTE) {
         ISAtom *pT = copyAtom(pV->pNext, nullptr, false);
-        symbols[pN->vals] = pT;
+        if (symbols.contains(id)) deleteList(symbols[id], "DelSymOnUpdate");
+        symbols[id] = pT;
       } else {
         ISAtom *pT = chainEval(pV, local_symbols, true);
-        if (symbols.find(pN->vals) != symbols.end()) deleteList(symbols[pN->vals], "DelSymOnUpdate", true);
-        symbols[pN->vals] = copyList(pT, false);
+        if (symbols.contains(id)) deleteList(symbols[id], "DelSymOnUpdate");
+        symbols[id] = copyList(pT, false);
         deleteList(pT, "makeDefine 1");  // XXX only 2nd argument? See QUOTE case
       }
       deleteList(pRes, "makeDefine 2");
-      return copyList(symbols[pN->vals]);
+      return shareList(symbols[id]);
       break;
     case ISAtom::TokType::LIST:
       pNa = pN->pChild;
@@ -1321,8 +2576,10 @@ class IndraScheme {
         if (!err) {
           ISAtom *pDef = copyList(pN, false);
           pNa = pN->pChild;
-          if (funcs.find(pNa->vals) != funcs.end()) deleteList(funcs[pNa->vals], "DelFuncOnUpdate", true);
-          funcs[pNa->vals] = pDef;
+          id = pNa->vals.symId();
+          retireFunc(id);
+          funcs[id] = pDef;
+          funcInfo[id] = analyzeFunc(pDef);
           pRes->t = ISAtom::TokType::NIL;
         }
       }
@@ -1336,27 +2593,27 @@ class IndraScheme {
     }
   }
 
-  void deleteDefine(string &name) {
-    if (is_defined_func(name)) {
-      deleteList(funcs[name], "DeleteFuncDefine " + name, true);
+  void deleteDefine(int id) {
+    if (is_defined_func(id)) {
+      retireFunc(id);
     }
-    if (is_defined_global_symbol(name)) {
-      deleteList(symbols[name], "DeleteSymDefine " + name, true);
+    if (is_defined_global_symbol(id)) {
+      deleteList(symbols[id], "DeleteSymDefine");
+      symbols.erase(id);
     }
   }
 
   void deleteAllDefines() {
-    for (auto sp : symbols) {
-      string name = sp.first;
-      deleteDefine(name);
+    for (int id : symbols.ids()) {
+      deleteDefine(id);
     }
-    for (auto sp : funcs) {
-      string name = sp.first;
-      deleteDefine(name);
+    for (int id : funcs.ids()) {
+      deleteDefine(id);
     }
+    if (evalDepth == 0) release_retired_funcs();
   }
 
-  ISAtom *makeLocalDefine(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *makeLocalDefine(const ISAtom *pisa, ISScopes &local_symbols) {
     vector<ISAtom *> pAllocs;
     ISAtom *pRes = gca();
     if (getListLen(pisa) < 1) {
@@ -1404,11 +2661,11 @@ class IndraScheme {
       ISAtom *pVal = pName->pNext;
       if (pVal->t == ISAtom::TokType::QUOTE) {
         ISAtom *pSym = copyAtom(pVal->pNext);
-        set_local_symbol(pName->vals, pSym, local_symbols);
+        set_local_symbol(pName->vals.symId(), pSym, local_symbols);
       } else {
         ISAtom *pT = chainEval(pVal, local_symbols, true);
         ISAtom *pSym = copyList(pT);
-        set_local_symbol(pName->vals, pSym, local_symbols);
+        set_local_symbol(pName->vals.symId(), pSym, local_symbols);
         deleteList(pT, "makeLocalDefine 4");
       }
       pDef = pDef->pNext;
@@ -1441,15 +2698,15 @@ class IndraScheme {
     }
   }
 
-  ISAtom *setLocalDefine(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *setLocalDefine(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     if (getListLen(pisa) != 2) {
       pRes->t = ISAtom::TokType::ERROR;
       pRes->vals = "'set!' requires 2 params: <existing-local-varname> <val>";
       return pRes;
     }
-    string varname = pisa->vals;
-    if (!is_defined_local_symbol(varname, local_symbols)) {
+    int varId = pisa->vals.findSymId();
+    if (!is_defined_local_symbol(varId, local_symbols)) {
       pRes->t = ISAtom::TokType::ERROR;
       pRes->vals = "'set!' requires existing local var name as first param";
       return pRes;
@@ -1458,9 +2715,10 @@ class IndraScheme {
     size_t len = local_symbols.size();
     bool bUpd = false;
     for (int in = (int)len - 1; in >= 0; in--) {
-      if (local_symbols[in].find(varname) != local_symbols[in].end()) {
-        deleteList(local_symbols[in][varname], "Set! 1");
-        local_symbols[in][varname] = copyList(newVal);
+      auto pos = local_symbols[in].find(varId);
+      if (pos != local_symbols[in].end()) {
+        deleteList(pos->second, "Set! 1");
+        pos->second = shareList(newVal);
         bUpd = true;
         break;
       }
@@ -1475,11 +2733,25 @@ class IndraScheme {
     return newVal;
   }
 
-  ISAtom *evalBegin(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *evalBegin(const ISAtom *pisa, ISScopes &local_symbols) {
     return chainEval(pisa, local_symbols, false);
   }
 
-  ISAtom *evalCond(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *evalAtom(const ISAtom *pisa, ISScopes &local_symbols) {
+    // eval() of a single operand in place. Symbols, errors and inline lambdas look at their
+    // pNext siblings, those are evaluated from a detached nursery copy instead.
+    if (pisa->t == ISAtom::TokType::QUOTE) return shareQuoted(pisa->pNext);
+    if (pisa->t == ISAtom::TokType::SYMBOL || pisa->t == ISAtom::TokType::ERROR ||
+        (pisa->t == ISAtom::TokType::LIST && pisa->pChild->vals == "lambda")) {
+      size_t nmark = nursery_mark();
+      ISAtom *pR = eval(nursery_add(copyAtom(pisa)), local_symbols);
+      nursery_release(nmark);
+      return pR;
+    }
+    return eval(pisa, local_symbols);
+  }
+
+  ISAtom *evalCond(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     if (getListLen(pisa) < 1) {
       pRes->t = ISAtom::TokType::ERROR;
@@ -1493,9 +2765,7 @@ class IndraScheme {
         pRes->vals = "'cond' operands must be lists with two elements (condition and expression), index " + std::to_string(i) + " invalid";
         return pRes;
       }
-      ISAtom *cond = copyAtom(ci->pChild);
-      ISAtom *pR = eval(cond, local_symbols);
-      deleteList(cond, "cond 00");
+      ISAtom *pR = evalAtom(ci->pChild, local_symbols);
       if (pR->t != ISAtom::TokType::BOOLEAN) {
         pRes->t = ISAtom::TokType::ERROR;
         pRes->vals = "'cond' first operands must eval to boolean, index " + std::to_string(i) + " invalid";
@@ -1515,50 +2785,37 @@ class IndraScheme {
     return pRes;
   }
 
-  ISAtom *evalIf(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *evalIf(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     if (getListLen(pisa) != 2 && getListLen(pisa) != 3) {
       pRes->t = ISAtom::TokType::ERROR;
       pRes->vals = "'if' requires 2 or 3 operands: <condition> <true-expr> [<false-expr>]";
       return pRes;
     }
-    ISAtom *pC = copyAtom(pisa);
-    ISAtom *pT = copyAtom(pisa->pNext);
-    ISAtom *pF = nullptr;
-
-    if (pisa->pNext->pNext) {
-      pF = copyAtom(pisa->pNext->pNext);
-    } else {
-      pF = nullptr;
-    }
+    const ISAtom *pT = pisa->pNext;
+    const ISAtom *pF = pT->pNext;
 
-    ISAtom *pR = eval(pC, local_symbols);
+    ISAtom *pR = evalAtom(pisa, local_symbols);
     if (pR->t != ISAtom::TokType::BOOLEAN) {
       pRes->t = ISAtom::TokType::ERROR;
       pRes->vals = "'if' condition should result in boolean, but we got: " + tokTypeNames[pR->t];
-      deleteList(pC, "if 1");
       deleteList(pR, "if 2");
-      deleteList(pT, "if 3");
-      deleteList(pF, "if 4");
       return pRes;
     }
     if (pR->val) {
       deleteList(pRes, "if 5");
-      pRes = eval(pT, local_symbols);
+      pRes = evalAtom(pT, local_symbols);
     } else {
-      if (pF) {
+      if (pF && pF->t != ISAtom::TokType::NIL) {
         deleteList(pRes, "if 6");
-        pRes = eval(pF, local_symbols);
+        pRes = evalAtom(pF, local_symbols);
       }
     }
-    deleteList(pC, "if 7");
     deleteList(pR, "if 8");
-    deleteList(pT, "if 9");
-    deleteList(pF, "if 10");
     return pRes;
   }
 
-  ISAtom *evalWhile(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *evalWhile(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     if (getListLen(pisa) < 2) {
       pRes->t = ISAtom::TokType::ERROR;
@@ -1581,6 +2838,13 @@ class IndraScheme {
     while (pCR->val) {
       if (pLast) deleteList(pLast, "while 3");
       pLast = chainEval(pL, local_symbols, true);
+      if (gcpool.overBudget) {
+        deleteList(pC, "while over budget");
+        deleteList(pCR, "while over budget");
+        deleteList(pRes, "while over budget");
+        deleteList(pLast, "while over budget");
+        return heapError();
+      }
 
       deleteList(pCR, "while 3.1");
       pCR = eval(pC, local_symbols);
@@ -1602,7 +2866,7 @@ class IndraScheme {
     return pLast;
   }
 
-  ISAtom *evalPrint(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *evalPrint(const ISAtom *pisa, ISScopes &local_symbols) {
     if (getListLen(pisa) < 1) {
       ISAtom *pRes = gca();
       pRes->t = ISAtom::TokType::ERROR;
@@ -1623,7 +2887,7 @@ class IndraScheme {
     return pResS;
   }
 
-  ISAtom *evalIndentedStringify(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *evalIndentedStringify(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pls = chainEval(pisa, local_symbols, true);
     if (getListLen(pls) < 2 || pls->t != ISAtom::TokType::INT) {
       ISAtom *pRes = gca();
@@ -1640,7 +2904,7 @@ class IndraScheme {
     return pRes;
   }
 
-  ISAtom *evalStringify(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *evalStringify(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pls = chainEval(pisa, local_symbols, true);
     if (getListLen(pls) < 1) {
       ISAtom *pRes = gca();
@@ -1656,7 +2920,7 @@ class IndraScheme {
     return pRes;
   }
 
-  ISAtom *evalListfunc(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *evalListfunc(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pls = chainEval(pisa, local_symbols, true);
     ISAtom *pRes = gca();
     if (getListLen(pls) < 1 || (pls->t != ISAtom::TokType::STRING && pls->t != ISAtom::TokType::SYMBOL) || (getListLen(pls) == 2 && pls->pNext->t != ISAtom::TokType::INT) ||
@@ -1667,15 +2931,16 @@ class IndraScheme {
       return pRes;
     }
     string funcname = pls->vals;
+    int id = pls->vals.findSymId();
     int tab_size = 0;
     if (getListLen(pls) == 2) tab_size = pls->pNext->val;
     deleteList(pls, "Listfunc 2");
-    if (!is_defined_func(funcname)) {
+    if (!is_defined_func(id)) {
       pRes->t = ISAtom::TokType::ERROR;
       pRes->vals = "'listfunc' function >" + funcname + "< is not defined";
       return pRes;
     }
-    string listfunc = stringify(funcs[funcname], local_symbols, ISAtom::DecorType::NONE, true, tab_size);
+    string listfunc = stringify(funcs[id], local_symbols, ISAtom::DecorType::NONE, true, tab_size);
     while (listfunc.length() > 0 and listfunc[listfunc.length() - 1] == ' ')
       listfunc = listfunc.substr(0, listfunc.length() - 1);  // remove trailing spaces
     pRes->t = ISAtom::TokType::STRING;
@@ -1683,12 +2948,12 @@ class IndraScheme {
     return pRes;
   }
 
-  ISAtom *evalQuote(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *evalQuote(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = copyList(pisa);
     return pRes;
   }
 
-  ISAtom *evalEvery(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *evalEvery(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     if (getListLen(pisa) < 2) {
       pRes->t = ISAtom::TokType::ERROR;
@@ -1704,6 +2969,7 @@ class IndraScheme {
       return pRes;
     }
     ISAtom *p, *pFi, *pC, *pCn;
+    ISAtom *pClosure = mapClosure(pisa, local_symbols);
     pC = gca();
     pC->t = ISAtom::TokType::LIST;
     pCn = pC;
@@ -1712,9 +2978,9 @@ class IndraScheme {
     while (p && p->t != ISAtom::TokType::NIL) {
       pFi = gca();
       pFi->t = ISAtom::TokType::LIST;
-      pFi->pChild = copyAtom(pisa);
+      pFi->pChild = pClosure ? gca() : copyAtom(pisa);
       pFi->pChild->pNext = copyAtom(p);
-      ISAtom *pR = eval(pFi, local_symbols);
+      ISAtom *pR = ownHead(pClosure ? closureApply(pClosure, pFi->pChild->pNext, local_symbols) : eval(pFi, local_symbols));
       if (first) {
         pCn->pChild = pR;
         pCn = pCn->pChild;
@@ -1731,10 +2997,11 @@ class IndraScheme {
     }
     deleteList(pL, "eval every 3");
     deleteList(pRes, "eval every 4");
+    deleteList(pClosure, "eval every 5");
     return pC;
   }
 
-  ISAtom *evalMap(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *evalMap(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     int rawNumArgs = getListLen(pisa);
     if (rawNumArgs < 2) {
@@ -1769,6 +3036,7 @@ class IndraScheme {
 
     int parmCnt = pParams.size();
     ISAtom *pFi, *pC, *pCn, *pParamI;
+    ISAtom *pClosure = mapClosure(pisa, local_symbols);
     pC = gca();
     pC->t = ISAtom::TokType::LIST;
     pCn = pC;
@@ -1777,7 +3045,7 @@ class IndraScheme {
     for (int i = 0; i < arg_len; i++) {
       pFi = gca();
       pFi->t = ISAtom::TokType::LIST;
-      pFi->pChild = copyAtom(pisa);
+      pFi->pChild = pClosure ? gca() : copyAtom(pisa);
       pParamI = pFi->pChild;
       for (int j = 0; j < parmCnt; j++) {
         pParamI->pNext = copyAtom(pParams[j]);
@@ -1794,7 +3062,7 @@ class IndraScheme {
         print(pFi, local_symbols, ISAtom::DecorType::UNICODE, true);
         cout << endl;
       }
-      ISAtom *pR = eval(pFi, local_symbols);
+      ISAtom *pR = ownHead(pClosure ? closureApply(pClosure, pFi->pChild->pNext, local_symbols) : eval(pFi, local_symbols));
       if (first) {
         pCn->pChild = pR;
         pCn = pCn->pChild;
@@ -1810,6 +3078,7 @@ class IndraScheme {
     }
     deleteList(pls, "eval map 3");
     deleteList(pRes, "eval map 4");
+    deleteList(pClosure, "eval map 5");
     return pC;
   }
 
@@ -1820,7 +3089,7 @@ class IndraScheme {
     return ISAtom::TokType::INVALID;
   }
 
-  ISAtom *evalType(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *evalType(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     ISAtom *pls = chainEval(pisa, local_symbols, true);
 
@@ -1836,7 +3105,7 @@ class IndraScheme {
     return pRes;
   }
 
-  ISAtom *evalConvtype(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *evalConvtype(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     ISAtom *pls = chainEval(pisa, local_symbols, true);
 
@@ -2093,7 +3362,7 @@ class IndraScheme {
   }
 
   ISAtom *
-  evalEval(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  evalEval(const ISAtom *pisa, ISScopes &local_symbols) {
     if (getListLen(pisa) < 1) {
       ISAtom *pRes = gca();
       pRes->t = ISAtom::TokType::ERROR;
@@ -2113,7 +3382,7 @@ class IndraScheme {
     return pResS;
   }
 
-  ISAtom *evalFind(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *evalFind(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     ISAtom *pls = chainEval(pisa, local_symbols, true);
     if (getListLen(pls) != 2 || ((pls->t != ISAtom::TokType::STRING || pls->pNext->t != ISAtom::TokType::STRING) && pls->t != ISAtom::TokType::LIST) || pls->pNext->t == ISAtom::TokType::LIST) {
@@ -2173,7 +3442,7 @@ class IndraScheme {
     }
   }
 
-  ISAtom *stringSubstring(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *stringSubstring(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     ISAtom *pls = chainEval(pisa, local_symbols, true);
     int r1 = 0, r2 = 0;
@@ -2207,7 +3476,7 @@ class IndraScheme {
     return pRes;
   }
 
-  ISAtom *stringSplitstring(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *stringSplitstring(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     ISAtom *pls = chainEval(pisa, local_symbols, true);
 
@@ -2284,7 +3553,7 @@ class IndraScheme {
     return pRes;
   }
 
-  ISAtom *stringLowercase(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *stringLowercase(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     ISAtom *pls = chainEval(pisa, local_symbols, true);
     if (getListLen(pls) != 1 || pls->t != ISAtom::TokType::STRING) {
@@ -2302,7 +3571,7 @@ class IndraScheme {
     return pRes;
   }
 
-  ISAtom *stringUppercase(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *stringUppercase(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     ISAtom *pls = chainEval(pisa, local_symbols, true);
     if (getListLen(pls) != 1 || pls->t != ISAtom::TokType::STRING) {
@@ -2320,7 +3589,7 @@ class IndraScheme {
     return pRes;
   }
 
-  ISAtom *stringReplace(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *stringReplace(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     ISAtom *pls = chainEval(pisa, local_symbols, true);
 
@@ -2348,7 +3617,7 @@ class IndraScheme {
     return pRes;
   }
 
-  ISAtom *listLength(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *listLength(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     ISAtom *p = (ISAtom *)pisa;
 
@@ -2366,7 +3635,7 @@ class IndraScheme {
     return pRes;
   }
 
-  ISAtom *listIndex(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *listIndex(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     ISAtom *pls = chainEval(pisa, local_symbols, true);
 
@@ -2400,7 +3669,7 @@ class IndraScheme {
     return pRes;
   }
 
-  ISAtom *listRange(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *listRange(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     ISAtom *pls = chainEval(pisa, local_symbols, true);
     int r1 = 0, r2;
@@ -2421,6 +3690,11 @@ class IndraScheme {
     ISAtom *p = pRes;
     bool first = true;
     for (int i = r1; i < r2; i++) {
+      if (gcpool.overBudget) {
+        deleteList(pRes, "listRange over budget");
+        deleteList(pls, "listRange over budget");
+        return heapError();
+      }
       if (first) {
         p->pChild = gca();
         p = p->pChild;
@@ -2441,7 +3715,7 @@ class IndraScheme {
     return pRes;
   }
 
-  ISAtom *listSublist(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *listSublist(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     ISAtom *pls = chainEval(pisa, local_symbols, true);
     int r1, r2;
@@ -2508,18 +3782,17 @@ class IndraScheme {
     return pRes;
   }
 
-  ISAtom *listList(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *listList(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pStart;
     ISAtom *pRes = gca();
     pStart = pRes;
     ISAtom *pls = chainEval(pisa, local_symbols, true);
     pRes->t = ISAtom::TokType::LIST;
-    pRes->pChild = copyList(pls);
-    deleteList(pls, "listList 1");
+    pRes->pChild = pls;
     return pStart;
   }
 
-  ISAtom *listCons(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *listCons(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     ISAtom *pStart = pRes;
     ISAtom *pls;
@@ -2563,7 +3836,7 @@ class IndraScheme {
     return pStart;
   }
 
-  ISAtom *listCar(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *listCar(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     if (getListLen(pisa) != 1) {
       pRes->t = ISAtom::TokType::ERROR;
@@ -2589,7 +3862,7 @@ class IndraScheme {
     return pCar;
   }
 
-  ISAtom *listCdr(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *listCdr(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     if (getListLen(pisa) != 1) {
       pRes->t = ISAtom::TokType::ERROR;
@@ -2612,16 +3885,16 @@ class IndraScheme {
     ISAtom *pCdr = gca();
     pCdr->t = ISAtom::TokType::LIST;
     if (pls->pChild->t == ISAtom::TokType::QUOTE) {
-      pCdr->pChild = copyList(pls->pChild->pNext->pNext);
+      pCdr->pChild = shareList(pls->pChild->pNext->pNext);
     } else {
-      pCdr->pChild = copyList(pls->pChild->pNext);
+      pCdr->pChild = shareList(pls->pChild->pNext);
     }
     deleteList(pRes, "cdr 3");
     deleteList(pls, "cdr 4");
     return pCdr;
   }
 
-  ISAtom *listAppend(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *listAppend(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     if (getListLen(pisa) != 2) {
       pRes->t = ISAtom::TokType::ERROR;
@@ -2681,7 +3954,7 @@ class IndraScheme {
     return pApp;
   }
 
-  ISAtom *listReverse(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
+  ISAtom *listReverse(const ISAtom *pisa, ISScopes &local_symbols) {
     ISAtom *pRes = gca();
     if (getListLen(pisa) != 1) {
       pRes->t = ISAtom::TokType::ERROR;
@@ -2700,6 +3973,9 @@ class IndraScheme {
       deleteList(pls, "listReverse 2");
       return pRes;
     }
+    ISAtom *pOwn = copyList(pls->pChild);  // relinked in place below, the evaluated operand may be shared
+    deleteList(pls->pChild, "listReverse 1");
+    pls->pChild = pOwn;
     vector<ISAtom *> lst;
     lst.push_back(pls->pChild);
     ISAtom *p = pls->pChild;
@@ -2735,241 +4011,2174 @@ class IndraScheme {
     deleteList(pRes, "listAppend 3");
     return pls;
   }
-
-  ISAtom *evalParse(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
-    ISAtom *pRes = gca();
-    if (getListLen(pisa) != 1) {
-      pRes->t = ISAtom::TokType::ERROR;
-      pRes->vals = "'parse' requires one operand that is parsed as expression: got " + std::to_string(getListLen(pisa));
-      return pRes;
+
+  ISAtom *evalParse(const ISAtom *pisa, ISScopes &local_symbols) {
+    ISAtom *pRes = gca();
+    if (getListLen(pisa) != 1) {
+      pRes->t = ISAtom::TokType::ERROR;
+      pRes->vals = "'parse' requires one operand that is parsed as expression: got " + std::to_string(getListLen(pisa));
+      return pRes;
+    }
+    ISAtom *pP = chainEval(pisa, local_symbols, true);
+    if (pP->t != ISAtom::TokType::STRING) {
+      pRes->t = ISAtom::TokType::ERROR;
+      pRes->vals = "'parse' requires a string to be parsed as parameter";
+      deleteList(pP, "evalParse 3");
+      return pRes;
+    }
+    string cmd = pP->vals;
+    deleteList(pP, "EvalParse 0");
+    cmd += " ";
+
+    if (cmd != "") {
+      int lvl = 0;
+      ISAtom *pisa_p = parse(cmd, nullptr, lvl);
+      ISAtom *pisa_res = chainEval(pisa_p, local_symbols, true);
+      deleteList(pisa_p, "evalParse 1");
+      deleteList(pRes, "evalParse 2");
+      return pisa_res;
+    } else {
+      pRes->t = ISAtom::TokType::NIL;
+      return pRes;
+    }
+  }
+
+  ISAtom *load(string filename, ISScopes &local_symbols) {
+    char buf[129];
+    size_t nb;
+    string cmd = "";
+    ISAtom *pRes;
+    FILE *fp = fopen(filename.c_str(), "r");
+    if (fp) {
+      while (!feof(fp)) {
+        nb = fread(buf, 1, 128, fp);
+        buf[nb] = 0;
+        cmd += buf;
+      }
+      fclose(fp);
+    } else {
+      pRes = gca();
+      pRes->t = ISAtom::TokType::ERROR;
+      pRes->vals = "Could not read file: " + filename;
+      return pRes;
+    }
+    if (cmd != "") {
+      return load_string(cmd, local_symbols);
+    } else {
+      pRes = gca();
+      pRes->t = ISAtom::TokType::ERROR;
+      pRes->vals = "Empty file: " + filename;
+      return pRes;
+    }
+  }
+
+  ISAtom *load_string(string source, ISScopes &local_symbols) {  // evaluates source as load() does a file's content
+    int lvl = 0;
+    ISAtom *pisa_p = parse(source, nullptr, lvl);
+    if (constFolding) foldChain(pisa_p);
+    ISAtom *pisa_res = chainEval(pisa_p, local_symbols, false);
+    deleteList(pisa_p, "evalLoad 4");
+    return pisa_res;
+  }
+
+  ISAtom *evalLoad(const ISAtom *pisa, ISScopes &local_symbols) {
+    ISAtom *pRes = gca();
+    ISAtom *pls = chainEval(pisa, local_symbols, true);
+    if (getListLen(pls) != 1) {
+      pRes->t = ISAtom::TokType::ERROR;
+      pRes->vals = "'load' requires one string operand, a filename, got: " + std::to_string(getListLen(pisa));
+      deleteList(pls, "load 1");
+      return pRes;
+    }
+    ISAtom *pP = (ISAtom *)pls;
+    if (pP->t != ISAtom::TokType::STRING) {
+      pRes->t = ISAtom::TokType::ERROR;
+      pRes->vals = "'load' requires a string operand, a filename";
+      deleteList(pls, "load 2");
+      return pRes;
+    }
+    ISAtom *pR = load(pP->vals, local_symbols);
+    deleteList(pls, "evalLoad 5.2");
+    deleteList(pRes, "evalLoad 5.3");
+    return pR;
+  }
+
+  bool is_inbuilt(int id) {
+    return inbuilts.contains(id);
+  }
+
+  ISAtom *eval_symbol(const ISAtom *pisa, ISScopes &local_symbols) {
+    ISAtom *p, *pn, *pRet;
+    int id = pisa->vals.symId();
+    p = get_local_symbol(id, local_symbols);
+    if (!p && symbols.contains(id)) p = shareList(symbols[id]);
+    if (p) {
+      while (p->t == ISAtom::TokType::SYMBOL) {
+        int pid = p->vals.symId();
+        if (is_defined_symbol(pid, local_symbols)) {
+          if (is_defined_local_symbol(pid, local_symbols)) {
+            pn = get_local_symbol(id, local_symbols);
+          } else {
+            pn = shareList(symbols[pid]);
+          }
+          deleteList(p, "eval_symbol 2");
+          p = pn;
+          if (p->t == ISAtom::TokType::SYMBOL && p->vals.symId() == id) {
+            break;
+          }
+        } else {
+          break;
+        }
+      }
+      return p;
+    } else {
+      pRet = gca();
+      pRet->t = ISAtom::TokType::ERROR;
+      pRet->vals = "Undefined symbol: " + pisa->vals;
+      return pRet;
+    }
+  }
+
+  void bind_args(const ISAtom *pInp, const vector<int> &paramIds, ISScopes &local_symbols) {
+    for (size_t i = 0; i < paramIds.size(); i++) {
+      bool bQuoted = false;
+      if (pInp->t == ISAtom::TokType::QUOTE) {
+        pInp = pInp->pNext;
+        bQuoted = true;
+      }
+      bool bDoEval = true;
+      if (pInp->t == ISAtom::TokType::STRING || pInp->t == ISAtom::TokType::SYMBOL) {
+        int id = pInp->vals.findSymId();
+        if (is_inbuilt(id) || is_defined_func(id)) {
+          bDoEval = false;
+        }
+      }
+      if (bQuoted) {
+        bDoEval = false;
+      }
+      ISAtom *pT;
+      if (bDoEval) {
+        pT = evalAtom(pInp, local_symbols);
+      } else {
+        pT = copyAtom(pInp);
+        pT->pNext = gca();
+      }
+
+      set_local_symbol(paramIds[i], pT, local_symbols);
+      pInp = pInp->pNext;
+    }
+  }
+
+  // Closures: a CLOSURE atom's child is its environment list, headed by a shared
+  // reference to the anchor, a private (lambda (params) body) copy keying the compiled
+  // function in lambdaFuncs, followed by a symbol per captured local with its value
+  // as child. The compiled function lives while its anchor is referenced by closures,
+  // running calls or the function the lambda was compiled with.
+  std::unordered_map<const ISAtom *, std::unique_ptr<ISFunc>> lambdaFuncs;
+  size_t lambdaSweepAt = 64;
+
+  int lambdaArity(const ISAtom *pParams) {  // pParams: the parameter list of a lambda, -1 if the form is invalid
+    if (!pParams || pParams->t != ISAtom::TokType::LIST || !pParams->pNext || pParams->pNext->t == ISAtom::TokType::NIL) return -1;
+    int n = 0;
+    for (const ISAtom *pNa = pParams->pChild; pNa && pNa->t != ISAtom::TokType::NIL; pNa = pNa->pNext) {
+      if (pNa->t != ISAtom::TokType::SYMBOL) return -1;
+      n++;
+    }
+    return n;
+  }
+
+  ISAtom *lambdaAnchor(const ISAtom *pParams) {  // compiles a valid lambda, pParams followed by the body
+    if (lambdaFuncs.size() >= lambdaSweepAt) sweepLambdas();
+    ISAtom *pAnchor = gca(nullptr, false);
+    pAnchor->t = ISAtom::TokType::LIST;
+    pAnchor->pChild = gca(nullptr, false);
+    pAnchor->pChild->t = ISAtom::TokType::SYMBOL;
+    pAnchor->pChild->vals = ISStr::intern("lambda");
+    pAnchor->pChild->pNext = copyList(pParams, false);
+    const ISAtom *pSrc = pAnchor->pChild->pNext;
+    std::unique_ptr<ISFunc> pFn = compileFunc(pSrc->pChild, pSrc->pNext, -1);
+    lambdaCaptures(pFn->pBody, *pFn);
+    lambdaFuncs[pAnchor] = std::move(pFn);
+    return pAnchor;
+  }
+
+  void lambdaCaptures(const ISAtom *p, ISFunc &fn) {  // free symbols of the body, quoted data excepted
+    bool bQuoted = false;
+    for (; p; p = p->pNext) {
+      if (p->t == ISAtom::TokType::QUOTE) {
+        bQuoted = true;
+        continue;
+      }
+      if (!bQuoted && p->t == ISAtom::TokType::SYMBOL) {
+        int id = p->vals.symId();
+        bool bKnown = is_inbuilt(id) || std::find(fn.paramIds.begin(), fn.paramIds.end(), id) != fn.paramIds.end();
+        for (const ISAtom *pC : fn.captures)
+          bKnown = bKnown || pC->vals.symId() == id;
+        if (!bKnown) fn.captures.push_back(p);
+      } else if (!bQuoted && p->t == ISAtom::TokType::LIST) {
+        lambdaCaptures(p->pChild, fn);
+      }
+      bQuoted = false;
+    }
+  }
+
+  // bCapture: bind the locals the body refers to as they are now. Lambdas applied
+  // right where they are written (map, every) see the live variables instead.
+  ISAtom *makeClosure(const ISAtom *pAnchor, const ISFunc &fn, ISScopes &local_symbols, bool bCapture) {
+    ISAtom *pRes = gca();
+    pRes->t = ISAtom::TokType::CLOSURE;
+    ISAtom *pEnv = gca(nullptr, false);  // like definitions, not counted as live data
+    pEnv->t = ISAtom::TokType::LIST;
+    pEnv->pChild = shareList(pAnchor);
+    pRes->pChild = pEnv;
+    if (!bCapture) return pRes;
+    for (const ISAtom *pSym : fn.captures) {
+      int id = pSym->vals.symId();
+      for (size_t i = local_symbols.size(); i-- > 0;) {
+        auto it = local_symbols[i].find(id);
+        if (it == local_symbols[i].end()) continue;
+        if (it->second) {
+          pEnv->pNext = gca(pSym, false);
+          pEnv = pEnv->pNext;
+          pEnv->pChild = shareList(it->second);
+        }
+        break;
+      }
+    }
+    return pRes;
+  }
+
+  ISAtom *makeLambda(const ISAtom *pisa, ISScopes &local_symbols) {
+    if (lambdaArity(pisa) < 0) {
+      ISAtom *pRes = gca();
+      pRes->t = ISAtom::TokType::ERROR;
+      pRes->vals = "'lambda' requires a list of parameter symbols and a body: (lambda (<symbol>...) <expr>)";
+      return pRes;
+    }
+    ISAtom *pAnchor = lambdaAnchor(pisa);
+    return makeClosure(pAnchor, *lambdaFuncs[pAnchor], local_symbols, true);
+  }
+
+  // Calls a closure like eval_func(): arguments are bound in the new frame, the captured
+  // locals after them, so they shadow the caller's variables of the same name.
+  ISAtom *closureApply(const ISAtom *pClosure, const ISAtom *pArgs, ISScopes &local_symbols) {
+    const ISAtom *pEnv = pClosure->pChild;
+    ISAtom *pAnchor = shareList(pEnv->pChild);  // keeps the code while it runs
+    const ISFunc &fn = *lambdaFuncs[pAnchor];
+    ISAtom *pRes;
+    int nArgs = pArgs ? getListLen(pArgs) : 0;
+    if (nArgs != fn.nParams) {
+      pRes = gca();
+      pRes->t = ISAtom::TokType::ERROR;
+      pRes->vals = "Lambda requires " + std::to_string(fn.nParams) + " arguments, " + std::to_string(nArgs) + " given";
+    } else {
+      local_symbols.push_back({});
+      if (nArgs) bind_args(pArgs, fn.paramIds, local_symbols);
+      for (const ISAtom *pCap = pEnv->pNext; pCap; pCap = pCap->pNext) {
+        ISFrame &frame = local_symbols.back();
+        if (frame.find(pCap->vals.symId()) == frame.end()) frame[pCap->vals.symId()] = shareList(pCap->pChild);
+      }
+      pRes = vmRun(fn, local_symbols);
+      pop_local_symbols(local_symbols);
+    }
+    deleteList(pAnchor, "closureApply");
+    return pRes;
+  }
+
+  // The function operand of map and every as a closure, nullptr: it's called by name.
+  ISAtom *mapClosure(const ISAtom *pisa, ISScopes &local_symbols) {
+    if (pisa->t == ISAtom::TokType::LIST && pisa->pChild && pisa->pChild->vals == "lambda" && lambdaArity(pisa->pChild->pNext) >= 0) {
+      auto it = mapLambdas.find(pisa);
+      const ISAtom *pAnchor = it != mapLambdas.end() ? it->second : lambdaAnchor(pisa->pChild->pNext);
+      return makeClosure(pAnchor, *lambdaFuncs[pAnchor], local_symbols, false);
+    }
+    if (pisa->t != ISAtom::TokType::SYMBOL) return nullptr;
+    int id = pisa->vals.symId();
+    if (is_inbuilt(id) || is_defined_func(id) || !is_defined_symbol(id, local_symbols)) return nullptr;
+    ISAtom *p = eval_symbol(pisa, local_symbols);
+    if (p->t == ISAtom::TokType::CLOSURE) return p;
+    deleteList(p, "mapClosure");
+    return nullptr;
+  }
+
+  // In-place lambdas of map and every within compiled bodies, form -> anchor. The anchor
+  // is held by the body's function, which drops the entry when it's released.
+  std::unordered_map<const ISAtom *, const ISAtom *> mapLambdas;
+
+  void dropMapForms(const ISFunc &fn) {
+    for (const ISAtom *pForm : fn.mapForms)
+      mapLambdas.erase(pForm);
+  }
+
+  void sweepLambdas() {  // drops the compiled lambdas nothing but lambdaFuncs refers to
+    bool bSwept = true;
+    while (bSwept) {
+      bSwept = false;
+      for (auto it = lambdaFuncs.begin(); it != lambdaFuncs.end();) {
+        if (gcpool.refs(it->first) > 1) {
+          ++it;
+          continue;
+        }
+        dropMapForms(*it->second);
+        deleteList((ISAtom *)it->second->pBody, "sweepLambdas body");
+        for (ISAtom *pAnchor : it->second->lambdas)
+          deleteList(pAnchor, "sweepLambdas inner");
+        deleteList((ISAtom *)it->first, "sweepLambdas");
+        it = lambdaFuncs.erase(it);
+        bSwept = true;
+      }
+    }
+    lambdaSweepAt = std::max((size_t)64, 2 * lambdaFuncs.size());
+  }
+
+  ISAtom *lambda_eval(const ISAtom *input_data, ISScopes &local_symbols, const ISAtom *pvars, const ISAtom *pfunc, int skipper = 0) {
+    ISAtom *p, *pRes;  // pRes is only needed for errors
+    local_symbols.push_back({});
+    ISAtom *pNa = pvars->pChild;  // pDef->pChild;
+    int n = 0;
+    bool err = false;
+
+    bool bDebugParams = false;
+    if (bDebugParams) {
+      cout << "InputData: ";
+      print(input_data, local_symbols, ISAtom::DecorType::UNICODE, true);
+      cout << endl;
+      cout << "pvars: ";
+      print(pvars, local_symbols, ISAtom::DecorType::UNICODE, true);
+      cout << endl;
+      cout << "pfunc: ";
+      print(pfunc, local_symbols, ISAtom::DecorType::UNICODE, true);
+      cout << endl;
+    }
+    while (pNa && !err) {
+      if (pNa->t == ISAtom::TokType::NIL) break;
+      if (pNa->t == ISAtom::TokType::SYMBOL) {
+        n = n + 1;
+        pNa = pNa->pNext;
+      } else {
+        err = true;
+        pRes = gca();
+        pRes->t = ISAtom::TokType::ERROR;
+        pRes->vals = "'lambda' function requires symbols as operands, type " + tokTypeNames[pNa->t] + " is invalid, symbol required.";
+        pop_local_symbols(local_symbols);
+        return pRes;
+        break;
+      }
+    }
+    if (getListLen(input_data) != n - skipper) {
+      err = true;
+      pRes = gca();
+      pRes->t = ISAtom::TokType::ERROR;
+      pRes->vals = "Lambda requires " + std::to_string(n - skipper) + " arguments, " + std::to_string(getListLen(input_data)) + " given";
+      pop_local_symbols(local_symbols);
+      return pRes;
+    }
+
+    vector<int> paramIds;
+    pNa = pvars->pChild;
+    for (int i = 0; i < skipper; i++)
+      pNa = pNa->pNext;
+    for (; n > skipper; n--, pNa = pNa->pNext)
+      paramIds.push_back(pNa->vals.symId());
+    bind_args(input_data, paramIds, local_symbols);
+    p = eval(pfunc, local_symbols);
+    pop_local_symbols(local_symbols);
+    return p;
+  }
+
+  ISAtom *eval_func(const ISAtom *pisa, ISScopes &local_symbols) {
+    ISAtom *pRes;
+    int id = pisa->vals.symId();
+    if (is_defined_func(id)) {
+      const ISFunc *pFn = funcInfo[id].get();
+      int nArgs = getListLen(pisa->pNext);
+      if (nArgs != pFn->nParams) {
+        pRes = gca();
+        pRes->t = ISAtom::TokType::ERROR;
+        pRes->vals = "Lambda requires " + std::to_string(pFn->nParams) + " arguments, " + std::to_string(nArgs) + " given";
+        return pRes;
+      }
+      local_symbols.push_back({});
+      bind_args(pisa->pNext, pFn->paramIds, local_symbols);
+      pRes = vmRun(*pFn, local_symbols);
+      pop_local_symbols(local_symbols);
+      return pRes;
+    } else {
+      pRes = gca();
+      pRes->t = ISAtom::TokType::ERROR;
+      pRes->vals = "Undefined function >" + pisa->vals + "< Internal error.";
+      return pRes;
+    }
+  }
+
+  // Constant folding: calls of pure inbuilts on literal operands are replaced by
+  // their value, if/cond branches behind a literal condition are dropped. It runs
+  // on the body copy an ISFunc compiles (funcs keeps the source as written) and on
+  // files read by load(). Quoted data and function defines are left alone, the
+  // latter are folded by analyzeFunc(). Replacing a foldable inbuilt with
+  // add_inbuilt() analyzes all functions again.
+  enum FoldOperands { FOLD_SCALARS = 1,  // INT, FLOAT and STRING literals
+                      FOLD_BOOLEANS = 2 };
+  bool constFolding = true;
+  ISSymMap<int> foldInbuilts;
+  ISScopes foldScopes;
+
+  static bool isFoldTarget(const ISAtom *p) {  // evaluates the same wherever a value is read
+    switch (p->t) {
+    case ISAtom::TokType::INT:
+    case ISAtom::TokType::FLOAT:
+    case ISAtom::TokType::STRING:
+    case ISAtom::TokType::BOOLEAN:
+      return true;
+    case ISAtom::TokType::LIST:
+      return p->pChild && p->pChild->t == ISAtom::TokType::SYMBOL && p->pChild->vals != "lambda";
+    default:
+      return false;
+    }
+  }
+
+  void foldChain(ISAtom *p) {  // the values of a chain, as chainEval() evaluates them
+    for (; p && p->t != ISAtom::TokType::NIL; p = p->pNext) {
+      if (p->t == ISAtom::TokType::QUOTE) {
+        p = p->pNext;
+        if (!p) break;
+      } else if (p->t == ISAtom::TokType::LIST) {
+        foldList(p, true);
+      }
+    }
+  }
+
+  void foldList(ISAtom *p, bool bValue) {  // bValue: p itself may be replaced by its value
+    ISAtom *pHead = p->pChild;
+    if (!pHead) return;
+    if (pHead->t == ISAtom::TokType::SYMBOL) {
+      if (pHead->vals == "quote") return;
+      if (pHead->vals == "define" && pHead->pNext && pHead->pNext->t == ISAtom::TokType::LIST) return;
+    } else if (pHead->t == ISAtom::TokType::LIST) {
+      foldList(pHead, false);
+    }
+    foldChain(pHead->pNext);
+    if (bValue && pHead->t == ISAtom::TokType::SYMBOL) foldCall(p);
+  }
+
+  void foldCall(ISAtom *p) {  // p: value position list with folded operands
+    ISAtom *pHead = p->pChild;
+    int id = pHead->vals.symId();
+    if (inbuilts[id] == &IndraScheme::evalIf) {
+      foldIf(p);
+      return;
+    }
+    if (inbuilts[id] == &IndraScheme::evalCond) {
+      foldCond(p);
+      return;
+    }
+    if (!foldInbuilts.contains(id)) return;
+    int accept = foldInbuilts[id];
+    const ISAtom *pOp = pHead->pNext;
+    for (; pOp && pOp->t != ISAtom::TokType::NIL; pOp = pOp->pNext) {
+      switch (pOp->t) {
+      case ISAtom::TokType::INT:
+      case ISAtom::TokType::FLOAT:
+      case ISAtom::TokType::STRING:
+        break;
+      case ISAtom::TokType::BOOLEAN:
+        if (accept & FOLD_BOOLEANS) break;
+        return;
+      default:
+        return;
+      }
+    }
+    if (pOp && pOp->pNext) return;
+    if (!foldScopes.size()) foldScopes.push_back(ISFrame{});
+    ++evalDepth;  // nested chainEval()s don't act as top level, and folding finishes no evaluation
+    ISAtom *pRes = call_inbuilt(id, pHead->pNext, foldScopes);
+    --evalDepth;
+    if (pRes->t != ISAtom::TokType::LIST && !pRes->pNext && isFoldTarget(pRes)) foldReplace(p, pRes);  // errors are reported at run time
+    deleteList(pRes, "foldCall");
+  }
+
+  void foldIf(ISAtom *p) {
+    ISAtom *pC = p->pChild->pNext;
+    if (!pC || pC->t != ISAtom::TokType::BOOLEAN) return;
+    ISAtom *pT = pC->pNext;
+    if (!pT || pT->t == ISAtom::TokType::NIL || pT->t == ISAtom::TokType::QUOTE) return;
+    ISAtom *pF = pT->pNext;
+    if (pF && pF->t == ISAtom::TokType::NIL) pF = nullptr;
+    if (pF && (pF->t == ISAtom::TokType::QUOTE || (pF->pNext && pF->pNext->t != ISAtom::TokType::NIL))) return;
+    ISAtom *pB = pC->val ? pT : pF;
+    if (!pB) return;
+    if (isFoldTarget(pB)) foldReplace(p, pB);
+  }
+
+  void foldCond(ISAtom *p) {
+    ISAtom *pHead = p->pChild;
+    bool bAllFalse = true;
+    for (ISAtom *pCl = pHead->pNext; pCl && pCl->t != ISAtom::TokType::NIL; pCl = pCl->pNext) {
+      if (pCl->t != ISAtom::TokType::LIST || !pCl->pChild || getListLen(pCl->pChild) != 2) return;
+      if (pCl->pChild->t == ISAtom::TokType::QUOTE || pCl->pChild->pNext->t == ISAtom::TokType::QUOTE) return;
+      if (pCl->pChild->t == ISAtom::TokType::LIST && pCl->pChild->pChild && pCl->pChild->pChild->t == ISAtom::TokType::SYMBOL) foldCall(pCl->pChild);
+      if (pCl->pChild->t != ISAtom::TokType::BOOLEAN || pCl->pChild->val) bAllFalse = false;
+    }
+    if (bAllFalse) return;
+    ISAtom **ppCl = &pHead->pNext;
+    while (*ppCl && (*ppCl)->t != ISAtom::TokType::NIL) {
+      ISAtom *pCl = *ppCl;
+      if (pCl->pChild->t != ISAtom::TokType::BOOLEAN) {
+        ppCl = &pCl->pNext;
+      } else if (!pCl->pChild->val) {  // never taken
+        *ppCl = pCl->pNext;
+        pCl->pNext = nullptr;
+        deleteList(pCl, "foldCond");
+      } else {  // always taken, the clauses after it are unreachable
+        ISAtom *pEnd = pCl->pNext;
+        while (pEnd && pEnd->t != ISAtom::TokType::NIL)
+          pEnd = pEnd->pNext;
+        ISAtom *pDead = pCl->pNext;
+        for (ISAtom *pD = pDead; pD; pD = pD->pNext) {
+          if (pD->pNext == pEnd) {
+            pD->pNext = nullptr;
+            deleteList(pDead, "foldCond");
+            break;
+          }
+        }
+        pCl->pNext = pEnd;
+        break;
+      }
+    }
+    ISAtom *pFirst = pHead->pNext;
+    if (pFirst->pChild->t == ISAtom::TokType::BOOLEAN) {
+      ISAtom *pE = pFirst->pChild->pNext;
+      if (isFoldTarget(pE)) foldReplace(p, pE);
+    }
+  }
+
+  void foldReplace(ISAtom *p, ISAtom *pVal) {  // p takes pVal's value, pVal may be part of p's list
+    ISAtom *pOld = p->pChild, *pNext = p->pNext;
+    ISAtom *pValChild = pVal->pChild;
+    pVal->pChild = nullptr;
+    *p = *pVal;
+    p->pNext = pNext;
+    p->pChild = pValChild;
+    deleteList(pOld, "foldReplace");
+  }
+
+  // Bytecode VM for user function bodies. makeDefine() analyzes a function once into an
+  // ISFunc record with its body compiled to ops. Ops evaluate exactly as the tree walker
+  // would, forms the compiler doesn't lower (define, lambda, ...) run through eval().
+  ISSymMap<std::unique_ptr<ISFunc>> funcInfo;
+  vector<ISAtom *> vmStack;
+  vector<size_t> vmMarks;
+  vector<const ISFunc *> vmCalls;
+  int vmSerial = 0;
+
+  // Redefinition bumps defEpoch, which invalidates all CALL inline caches. The old
+  // definition may still be running, it is kept until the outermost evaluation ends.
+  unsigned defEpoch = 1;
+  vector<ISAtom *> funcRetiredDefs;
+  vector<std::unique_ptr<ISFunc>> funcRetired;
+
+  void retireFunc(int id) {
+    ++defEpoch;
+    if (funcs.contains(id)) {
+      funcRetiredDefs.push_back(funcs[id]);
+      funcs.erase(id);
+    }
+    if (funcInfo.contains(id)) {
+      funcRetiredDefs.push_back((ISAtom *)funcInfo[id]->pBody);
+      funcRetired.push_back(std::move(funcInfo[id]));
+      funcInfo.erase(id);
+    }
+  }
+
+  void reanalyzeFuncs() {
+    for (int id : funcInfo.ids()) {
+      ISAtom *pDef = funcs[id];
+      int serial = funcInfo[id]->serial;
+      funcs.erase(id);
+      retireFunc(id);
+      funcs[id] = pDef;
+      funcInfo[id] = analyzeFunc(pDef);
+      funcInfo[id]->serial = serial;  // still the same definition
+    }
+  }
+
+  void release_retired_funcs() {
+    for (ISAtom *pDef : funcRetiredDefs)
+      deleteList(pDef, "DelFuncOnUpdate");
+    funcRetiredDefs.clear();
+    for (auto &pFn : funcRetired) {
+      dropMapForms(*pFn);
+      for (ISAtom *pAnchor : pFn->lambdas)
+        deleteList(pAnchor, "DelFuncOnUpdate");
+    }
+    funcRetired.clear();
+    sweepLambdas();
+  }
+
+  // Lexical addressing: while compiling, vmScopes mirrors the frames the body will
+  // have pushed at each point, innermost last, with ids in slot order. Within a body
+  // the innermost binding of such a name is always the lexical one, so it is read as
+  // (depth, slot); names bound outside the body stay dynamic lookups. An opaque scope
+  // ({-1}) is the frame of a callee unknown at compile time.
+  vector<vector<int>> vmScopes;
+  const ISFunc *vmCompiling = nullptr;
+  int vmCompilingId = -1;
+  vector<ISAtom *> vmLambdas;  // anchors of the lambdas compiled so far, see vmCompileLambda()
+  vector<const ISAtom *> vmMapForms;
+
+  std::unique_ptr<ISFunc> analyzeFunc(const ISAtom *pDef) {  // pDef: validated (name params...) list followed by the body
+    return compileFunc(pDef->pChild->pNext, pDef->pNext, pDef->pChild->vals.symId());
+  }
+
+  // pParams: chain of parameter symbols, selfId: the function's name, -1 for lambdas.
+  // Lambdas within the body are compiled on the way, so the state is saved.
+  std::unique_ptr<ISFunc> compileFunc(const ISAtom *pParams, const ISAtom *pBodySrc, int selfId) {
+    std::unique_ptr<ISFunc> pFn(new ISFunc());
+    for (const ISAtom *pNa = pParams; pNa && pNa->t != ISAtom::TokType::NIL; pNa = pNa->pNext) {
+      pFn->paramIds.push_back(pNa->vals.symId());
+    }
+    pFn->serial = ++vmSerial;
+    pFn->nParams = (int)pFn->paramIds.size();
+    ISAtom *pBody = copyList(pBodySrc, false);
+    if (constFolding) foldChain(pBody);
+    pFn->pBody = pBody;
+    vector<vector<int>> scopes;
+    vector<ISAtom *> lambdas;
+    vector<const ISAtom *> mapForms;
+    scopes.swap(vmScopes);
+    lambdas.swap(vmLambdas);
+    mapForms.swap(vmMapForms);
+    const ISFunc *pCompiling = vmCompiling;
+    int compilingId = vmCompilingId;
+    vmCompiling = pFn.get();
+    vmCompilingId = selfId;
+    vmScopes.assign(1, {});
+    for (int id : pFn->paramIds)
+      vmScopeBind(id);
+    vmCompileEval(pFn->pBody, pFn->ops);
+    vmMarkTailCalls(pFn->ops);
+    pFn->lambdas.swap(vmLambdas);
+    pFn->mapForms.swap(vmMapForms);
+    vmScopes.swap(scopes);
+    vmLambdas.swap(lambdas);
+    vmMapForms.swap(mapForms);
+    vmCompiling = pCompiling;
+    vmCompilingId = compilingId;
+    return pFn;
+  }
+
+  void vmMarkTailCalls(vector<ISOp> &ops) {  // INVOKEs whose result is the body's result
+    for (size_t i = 0; i < ops.size(); i++) {
+      if (ops[i].op != ISOp::INVOKE) continue;
+      size_t j = i + 1;
+      while (j < ops.size() && (ops[j].op == ISOp::JUMP || ops[j].op == ISOp::SCOPE_POP))
+        j = ops[j].op == ISOp::JUMP ? ops[j].a : j + 1;
+      ops[i].c = j == ops.size();
+    }
+  }
+
+  void vmScopeBind(int id) {  // compile-time set_local_symbol() into the innermost frame
+    vector<int> &scope = vmScopes.back();
+    if (std::find(scope.begin(), scope.end(), id) == scope.end()) scope.push_back(id);
+  }
+
+  bool vmResolve(int id, int &depth, int &slot) {
+    for (int d = 0; d < (int)vmScopes.size(); d++) {
+      const vector<int> &scope = vmScopes[vmScopes.size() - 1 - d];
+      if (scope.size() == 1 && scope[0] == -1) return false;
+      auto it = std::find(scope.begin(), scope.end(), id);
+      if (it != scope.end()) {
+        depth = d;
+        slot = (int)(it - scope.begin());
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void vmEmitSymbol(vector<ISOp> &ops, const ISAtom *pisa, bool bInPlace) {  // eval(pisa) or evalAtom(pisa) of a symbol
+    int id = pisa->vals.symId(), depth, slot;
+    if (!is_inbuilt(id) && vmResolve(id, depth, slot)) {
+      vmEmit(ops, ISOp::LOCAL, pisa, depth, slot, bInPlace);
+    } else {
+      vmEmit(ops, bInPlace ? ISOp::EVAL : ISOp::EVAL_ATOM, pisa);
+    }
+  }
+
+  size_t vmEmit(vector<ISOp> &ops, ISOp::Code op, const ISAtom *p = nullptr, int a = 0, int b = 0, int c = 0) {
+    ops.push_back({op, a, b, c, p, 0, nullptr});
+    return ops.size() - 1;
+  }
+
+  void vmPatch(vector<ISOp> &ops, const vector<size_t> &jumps) {
+    for (size_t i : jumps)
+      ops[i].a = (int)ops.size();
+  }
+
+  void vmCompileEval(const ISAtom *pisa, vector<ISOp> &ops) {  // eval(pisa) in place
+    switch (pisa->t) {
+    case ISAtom::TokType::LIST:
+      if ((!pisa->pNext || pisa->pNext->t == ISAtom::TokType::NIL) && vmCompileClosure(pisa, ops)) break;
+      if (!pisa->pChild || pisa->pChild->vals == "lambda") {
+        vmEmit(ops, ISOp::EVAL, pisa);
+      } else {
+        vmCompileCall(pisa->pChild, ops);
+      }
+      break;
+    case ISAtom::TokType::SYMBOL:
+      vmEmitSymbol(ops, pisa, true);
+      break;
+    case ISAtom::TokType::QUOTE:
+    case ISAtom::TokType::ERROR:
+      vmEmit(ops, ISOp::EVAL, pisa);
+      break;
+    default:
+      vmEmit(ops, ISOp::CONST, pisa);
+      break;
+    }
+  }
+
+  void vmCompileAtom(const ISAtom *pisa, vector<ISOp> &ops) {  // evalAtom(pisa)
+    switch (pisa->t) {
+    case ISAtom::TokType::QUOTE:
+      vmEmit(ops, ISOp::QUOTE_ATOM, pisa);
+      break;
+    case ISAtom::TokType::SYMBOL:
+      vmEmitSymbol(ops, pisa, false);
+      break;
+    case ISAtom::TokType::ERROR:
+      vmEmit(ops, ISOp::EVAL_ATOM, pisa);
+      break;
+    case ISAtom::TokType::LIST:
+      if (vmCompileClosure(pisa, ops)) break;
+      if (!pisa->pChild || pisa->pChild->vals == "lambda") {
+        vmEmit(ops, ISOp::EVAL_ATOM, pisa);
+      } else {
+        vmCompileCall(pisa->pChild, ops);
+      }
+      break;
+    default:
+      vmEmit(ops, ISOp::CONST, pisa);
+      break;
+    }
+  }
+
+  bool vmCompileChain(const ISAtom *pisa, vector<ISOp> &ops, bool bChainResult, vector<size_t> &bails) {  // chainEval(pisa)
+    bool is_quote = false, bFirst = true;
+    for (const ISAtom *p = pisa; p && p->t != ISAtom::TokType::NIL; p = p->pNext) {
+      if (p->t == ISAtom::TokType::QUOTE) {
+        if (is_quote) return false;
+        is_quote = true;
+        continue;
+      }
+      if (!bChainResult && !bFirst) {
+        bails.push_back(vmEmit(ops, ISOp::JUMP_IF_ERROR));
+        vmEmit(ops, ISOp::POP);
+      }
+      switch (p->t) {
+      case ISAtom::TokType::SYMBOL:
+        if (is_quote) {
+          vmEmit(ops, ISOp::SYM, p);
+        } else {
+          int depth = -1, slot = 0;
+          vmResolve(p->vals.symId(), depth, slot);
+          vmEmit(ops, ISOp::LOAD, p, depth, slot);
+        }
+        break;
+      case ISAtom::TokType::LIST:
+        if (is_quote) {
+          vmEmit(ops, ISOp::QUOTED, p);
+        } else if (!p->pChild) {
+          return false;
+        } else if (p->pChild->pChild) {
+          vmEmit(ops, ISOp::EVAL_FN, p->pChild, 1);
+        } else {
+          vmCompileCall(p->pChild, ops);
+        }
+        break;
+      default:
+        vmEmit(ops, ISOp::CONST, p);
+        break;
+      }
+      is_quote = false;
+      bFirst = false;
+      if (bChainResult) bails.push_back(vmEmit(ops, ISOp::BAIL));
+    }
+    if (!bChainResult && bFirst) vmEmit(ops, ISOp::NIL);
+    return !is_quote;
+  }
+
+  // Lambdas in compiled bodies are compiled once, with the body that contains them.
+  // pSym: the lambda symbol of a valid form, followed by the parameters and the body.
+  const ISAtom *vmCompileLambda(const ISAtom *pSym) {
+    ISAtom *pAnchor = lambdaAnchor(pSym->pNext);
+    vmLambdas.push_back(shareList(pAnchor));
+    return pAnchor;
+  }
+
+  void vmCompileMapLambda(const ISAtom *pForm) {  // the function operand of map or every, see mapClosure()
+    if (!pForm || pForm->t != ISAtom::TokType::LIST || !pForm->pChild || pForm->pChild->vals != "lambda" || lambdaArity(pForm->pChild->pNext) < 0) return;
+    if (mapLambdas.count(pForm)) return;
+    mapLambdas[pForm] = vmCompileLambda(pForm->pChild);
+    vmMapForms.push_back(pForm);
+  }
+
+  void vmEmitClosure(const ISAtom *pSym, vector<ISOp> &ops) {
+    const ISAtom *pAnchor = vmCompileLambda(pSym);
+    size_t i = vmEmit(ops, ISOp::CLOSURE, pAnchor);
+    ops[i].pCached = lambdaFuncs[pAnchor].get();
+  }
+
+  bool vmCompileClosure(const ISAtom *pisa, vector<ISOp> &ops) {  // a (lambda (params) body) list evaluated as a value
+    if (!pisa->pChild || pisa->pChild->vals != "lambda" || lambdaArity(pisa->pChild->pNext) < 0) return false;
+    vmEmitClosure(pisa->pChild, ops);
+    return true;
+  }
+
+  void vmCompileCall(const ISAtom *pHead, vector<ISOp> &ops) {  // eval(pHead, local_symbols, true)
+    // Arguments are evaluated with the callee's frame already pushed and its earlier
+    // parameters bound (see lambda_eval), so addresses are compiled against the callee
+    // expected now. CALL falls back to eval() if a different definition is found.
+    const ISAtom *pInp = pHead->pNext;
+    int argc = pInp ? getListLen(pInp) : 0;
+    size_t start = ops.size();
+    const ISFunc *pCallee = nullptr;
+    size_t iCall;
+    if (pHead->t == ISAtom::TokType::LIST && pHead->pChild && pHead->pChild->vals == "lambda" && argc > 0 && lambdaArity(pHead->pChild->pNext) == argc) {
+      pCallee = lambdaFuncs[vmCompileLambda(pHead->pChild)].get();  // ((lambda (params) body) args)
+      iCall = vmEmit(ops, ISOp::CALL_LAMBDA, pHead, argc);
+      ops[iCall].pCached = pCallee;
+    } else if (pHead->t != ISAtom::TokType::SYMBOL) {
+      vmEmit(ops, ISOp::EVAL_FN, pHead);
+      return;
+    } else {
+      int id = pHead->vals.symId();
+      if (is_inbuilt(id)) {
+        if (inbuilts[id] == &IndraScheme::evalMap || inbuilts[id] == &IndraScheme::evalEvery) vmCompileMapLambda(pHead->pNext);
+        size_t nScopes = vmScopes.size();
+        if (!vmCompileInbuilt(pHead, ops)) {
+          vmScopes.resize(nScopes);
+          ops.resize(start);
+          vmEmit(ops, ISOp::BUILTIN, pHead->pNext, id);
+        }
+        return;
+      }
+      if (vmCompiling && id == vmCompilingId) {
+        pCallee = vmCompiling;
+      } else if (funcInfo.contains(id)) {
+        pCallee = funcInfo[id].get();
+      }
+      if (pCallee && pCallee->nParams != argc) pCallee = nullptr;
+      iCall = vmEmit(ops, ISOp::CALL, pHead, argc, 0, pCallee ? pCallee->serial : 0);
+    }
+    vmScopes.push_back(pCallee ? vector<int>() : vector<int>{-1});
+    for (int i = 0; i < argc && pInp; i++) {
+      if (pInp->t == ISAtom::TokType::QUOTE) {
+        pInp = pInp->pNext;
+        if (!pInp) break;
+        vmEmit(ops, ISOp::COPY_NIL, pInp);
+      } else if (pInp->t == ISAtom::TokType::STRING || pInp->t == ISAtom::TokType::SYMBOL) {
+        int depth = -1, slot = 0;
+        if (pInp->t == ISAtom::TokType::SYMBOL) vmResolve(pInp->vals.symId(), depth, slot);
+        vmEmit(ops, ISOp::ARG_NAME, pInp, depth, slot);
+      } else {
+        vmCompileAtom(pInp, ops);
+      }
+      vmEmit(ops, ISOp::BIND_PARAM, nullptr, i);
+      if (pCallee) vmScopeBind(pCallee->paramIds[i]);
+      pInp = pInp->pNext;
+      if (i == argc - 1) {
+        vmScopes.pop_back();
+        vmEmit(ops, ISOp::INVOKE);
+        ops[iCall].b = (int)ops.size();
+        return;
+      }
+    }
+    vmScopes.pop_back();
+    ops.resize(start);
+    if (argc == 0 && pHead->pNext) {
+      vmEmit(ops, ISOp::CALL, pHead, 0, (int)start + 2);
+      vmEmit(ops, ISOp::INVOKE);
+    } else {
+      vmEmit(ops, ISOp::EVAL_FN, pHead);
+    }
+  }
+
+  // Escape analysis for let: can the value bound to id outlive the let? bValue: the
+  // result of pisa may become the let's result. Any call that isn't a known consumer
+  // counts as an escape, since callees see the binding through dynamic scoping.
+  bool vmEscapes(int id, const ISAtom *pisa, bool bValue) {
+    if (pisa->t == ISAtom::TokType::SYMBOL) return bValue && pisa->vals.symId() == id;
+    if (pisa->t != ISAtom::TokType::LIST || !pisa->pChild) return false;
+    const ISAtom *pHead = pisa->pChild;
+    if (pHead->t != ISAtom::TokType::SYMBOL || !is_inbuilt(pHead->vals.symId()) || inbuilts[pHead->vals.symId()] == &IndraScheme::evalExtInbuilt) return true;
+    static const vector<string> consumers = {"+", "-", "*", "/", "%", "==", "!=", ">=", "<=", "<", ">", "and", "or", "print", "stringify", "indentedstringify", "length"};
+    const string &name = pHead->vals;
+    bool bConsumer = std::find(consumers.begin(), consumers.end(), name) != consumers.end();
+    if (name == "quote") return false;
+    if (!bConsumer && name != "begin" && name != "if" && name != "cond" && name != "while" && name != "set!" && name != "let") return true;
+    bool bFirst = true;
+    for (const ISAtom *p = pHead->pNext; p && p->t != ISAtom::TokType::NIL; p = p->pNext) {
+      if (p->t == ISAtom::TokType::QUOTE) {
+        if (p->pNext) p = p->pNext;
+        continue;
+      }
+      bool bLast = !p->pNext || p->pNext->t == ISAtom::TokType::NIL;
+      bool bEsc = false;
+      if (bConsumer) {
+        bEsc = vmEscapes(id, p, false);
+      } else if (name == "cond") {
+        if (p->t != ISAtom::TokType::LIST) return true;
+        for (const ISAtom *pc = p->pChild; pc && pc->t != ISAtom::TokType::NIL && !bEsc; pc = pc->pNext)
+          bEsc = vmEscapes(id, pc, bValue && (!pc->pNext || pc->pNext->t == ISAtom::TokType::NIL));
+      } else if (name == "let" && bFirst) {
+        if (p->t != ISAtom::TokType::LIST) return true;
+        for (const ISAtom *pDef = p->pChild; pDef && pDef->t == ISAtom::TokType::LIST && !bEsc; pDef = pDef->pNext)
+          bEsc = pDef->pChild && pDef->pChild->pNext && vmEscapes(id, pDef->pChild->pNext, true);
+      } else if (name == "set!") {
+        bEsc = !bFirst && vmEscapes(id, p, true);
+      } else if (name == "begin" || name == "let") {
+        bEsc = vmEscapes(id, p, bValue && bLast);
+      } else {  // if, while: the test is consumed
+        bEsc = vmEscapes(id, p, bValue && !bFirst);
+      }
+      if (bEsc) return true;
+      bFirst = false;
+    }
+    return false;
+  }
+
+  // A binding that doesn't escape keeps the value it was evaluated to: values are
+  // shared copy-on-write, so the private copy is only needed for what outlives the let.
+  bool vmLetEscapes(int id, const ISAtom *pDefs, const ISAtom *pBody) {
+    for (const ISAtom *pDef = pDefs; pDef && pDef->t != ISAtom::TokType::NIL; pDef = pDef->pNext) {
+      if (vmEscapes(id, pDef->pChild->pNext, true)) return true;
+    }
+    for (const ISAtom *pExpr = pBody; pExpr && pExpr->t != ISAtom::TokType::NIL; pExpr = pExpr->pNext) {
+      if (vmEscapes(id, pExpr, !pExpr->pNext || pExpr->pNext->t == ISAtom::TokType::NIL)) return true;
+    }
+    return false;
+  }
+
+  bool vmCompileInbuilt(const ISAtom *pHead, vector<ISOp> &ops) {  // native lowering of core forms, false: call the inbuilt
+    const ISAtom *pisa = pHead->pNext;
+    if (!pisa || inbuilts[pHead->vals.symId()] == &IndraScheme::evalExtInbuilt) return false;
+    const string &name = pHead->vals;
+    vector<size_t> jumps;
+    if (name.length() == 1 && string("+-*/%").find(name[0]) != string::npos) {
+      if (getListLen(pisa) < 2) return false;
+      int iFused = vmEmitFused(ops, ISOp::MATH2, pisa);
+      vmEmit(ops, ISOp::MARK);
+      if (!vmCompileChain(pisa, ops, true, jumps)) return false;
+      vmPatch(ops, jumps);
+      vmEmit(ops, ISOp::MATH, pHead, 0, 0, (int)string("+-*/%").find(name[0]));
+      if (iFused >= 0) ops[iFused].c = (int)ops.size();
+      return true;
+    }
+    for (int m_op = CMP_EQ; m_op <= CMP_OR; m_op++) {
+      if (name != cmp_op_name(m_op)) continue;
+      if (getListLen(pisa) != 2) return false;
+      int iFused = vmEmitFused(ops, ISOp::CMP2, pisa);
+      vmEmit(ops, ISOp::MARK);
+      if (!vmCompileChain(pisa, ops, true, jumps)) return false;
+      vmPatch(ops, jumps);
+      vmEmit(ops, ISOp::CMP, pHead, 0, 0, m_op);
+      if (iFused >= 0) ops[iFused].c = (int)ops.size();
+      return true;
+    }
+    if (name == "begin") {
+      if (!vmCompileChain(pisa, ops, false, jumps)) return false;
+      vmPatch(ops, jumps);
+      return true;
+    }
+    if (name == "if") {
+      if ((getListLen(pisa) != 2 && getListLen(pisa) != 3) || !pisa->pNext) return false;
+      const ISAtom *pT = pisa->pNext;
+      const ISAtom *pF = pT->pNext;
+      vmCompileAtom(pisa, ops);
+      size_t iTest = vmEmit(ops, ISOp::IF_TEST);
+      vmCompileAtom(pT, ops);
+      size_t iJump = vmEmit(ops, ISOp::JUMP);
+      ops[iTest].a = (int)ops.size();
+      if (pF && pF->t != ISAtom::TokType::NIL) {
+        vmCompileAtom(pF, ops);
+      } else {
+        vmEmit(ops, ISOp::NIL);
+      }
+      ops[iJump].a = ops[iTest].b = (int)ops.size();
+      return true;
+    }
+    if (name == "cond") {
+      int n = getListLen(pisa);
+      if (n < 1) return false;
+      for (int i = 0; i < n; i++) {
+        const ISAtom *ci = getListArgN(pisa, i);
+        if (ci->t != ISAtom::TokType::LIST || getListLen(ci->pChild) != 2) return false;
+      }
+      vector<size_t> tests;
+      for (int i = 0; i < n; i++) {
+        const ISAtom *ci = getListArgN(pisa, i);
+        vmCompileAtom(ci->pChild, ops);
+        size_t iTest = vmEmit(ops, ISOp::COND_TEST, nullptr, 0, 0, i);
+        tests.push_back(iTest);
+        vmCompileEval(ci->pChild->pNext, ops);
+        jumps.push_back(vmEmit(ops, ISOp::JUMP));
+        ops[iTest].a = (int)ops.size();
+      }
+      vmEmit(ops, ISOp::NIL);
+      vmPatch(ops, jumps);
+      for (size_t i : tests)
+        ops[i].b = (int)ops.size();
+      return true;
+    }
+    if (name == "while") {
+      if (getListLen(pisa) < 2 || pisa->t == ISAtom::TokType::QUOTE) return false;
+      vmEmit(ops, ISOp::PUSH_NULL);
+      size_t iLoop = ops.size();
+      vmCompileAtom(pisa, ops);
+      size_t iTest = vmEmit(ops, ISOp::WHILE_TEST);
+      vmEmit(ops, ISOp::MARK);
+      if (!vmCompileChain(pisa->pNext, ops, true, jumps)) return false;
+      vmPatch(ops, jumps);
+      vmEmit(ops, ISOp::CHAIN);
+      size_t iBudget = vmEmit(ops, ISOp::BUDGET);
+      vmEmit(ops, ISOp::JUMP, nullptr, (int)iLoop);
+      ops[iTest].a = (int)ops.size();
+      vmEmit(ops, ISOp::NULL_TO_NIL);
+      ops[iTest].b = ops[iBudget].a = (int)ops.size();
+      return true;
+    }
+    if (name == "set!") {
+      if (getListLen(pisa) != 2 || pisa->t != ISAtom::TokType::SYMBOL) return false;
+      int varId = pisa->vals.symId(), depth, slot, delta;
+      if (vmResolve(varId, depth, slot)) {
+        int iFused = -1;
+        if (slot <= 0xffff && vmIncrement(pisa, delta)) iFused = (int)vmEmit(ops, ISOp::ADD_LOCAL, nullptr, vmAddr(depth, slot), delta);
+        vmCompileEval(pisa->pNext, ops);
+        vmEmit(ops, ISOp::SET_LOCAL, nullptr, depth, slot);
+        if (iFused >= 0) ops[iFused].c = (int)ops.size();
+        return true;
+      }
+      size_t iCheck = vmEmit(ops, ISOp::SET_CHECK, nullptr, varId);
+      vmCompileEval(pisa->pNext, ops);
+      vmEmit(ops, ISOp::SET, nullptr, varId);
+      ops[iCheck].b = (int)ops.size();
+      return true;
+    }
+    if (name == "lambda") {
+      if (lambdaArity(pisa) < 0) return false;
+      vmEmitClosure(pHead, ops);
+      return true;
+    }
+    if (name == "let") {
+      if (getListLen(pisa) < 1 || pisa->t != ISAtom::TokType::LIST || !pisa->pNext) return false;
+      for (const ISAtom *pDef = pisa->pChild; pDef && pDef->t != ISAtom::TokType::NIL; pDef = pDef->pNext) {
+        if (pDef->t != ISAtom::TokType::LIST || getListLen(pDef->pChild) != 2 || pDef->pChild->t != ISAtom::TokType::SYMBOL) return false;
+      }
+      vmEmit(ops, ISOp::SCOPE_PUSH);
+      vmScopes.push_back({});
+      for (const ISAtom *pDef = pisa->pChild; pDef && pDef->t != ISAtom::TokType::NIL; pDef = pDef->pNext) {
+        const ISAtom *pName = pDef->pChild;
+        const ISAtom *pVal = pName->pNext;
+        if (pVal->t == ISAtom::TokType::QUOTE) {
+          vmEmit(ops, ISOp::CONST, pVal->pNext);
+        } else {
+          vmEmit(ops, ISOp::MARK);
+          if (!vmCompileChain(pVal, ops, true, jumps)) return false;
+          vmPatch(ops, jumps);
+          jumps.clear();
+          vmEmit(ops, ISOp::CHAIN);
+          if (vmLetEscapes(pName->vals.symId(), pDef->pNext, pisa->pNext)) vmEmit(ops, ISOp::COPYLIST);
+        }
+        vmEmit(ops, ISOp::BIND, nullptr, pName->vals.symId());
+        vmScopeBind(pName->vals.symId());
+      }
+      bool bFirst = true;
+      for (const ISAtom *pExpr = pisa->pNext; pExpr && pExpr->t != ISAtom::TokType::NIL; pExpr = pExpr->pNext) {
+        if (!bFirst) vmEmit(ops, ISOp::POP);
+        vmCompileEval(pExpr, ops);
+        bFirst = false;
+      }
+      if (bFirst) vmEmit(ops, ISOp::NIL);
+      vmEmit(ops, ISOp::SCOPE_POP);
+      vmScopes.pop_back();
+      return true;
+    }
+    return false;
+  }
+
+  // Fused ops address locals by a packed (depth, slot).
+  static int vmAddr(int depth, int slot) {
+    return depth << 16 | slot;
+  }
+
+  static ISAtom *&vmSlot(int addr, ISScopes &local_symbols) {
+    return local_symbols[local_symbols.size() - 1 - (addr >> 16)].slot(addr & 0xffff);
+  }
+
+  bool vmFusedOperand(const ISAtom *p, int &addr) {  // a local read in place, or a literal (addr -1)
+    int depth, slot;
+    switch (p->t) {
+    case ISAtom::TokType::SYMBOL:
+      if (!vmResolve(p->vals.symId(), depth, slot) || slot > 0xffff) return false;
+      addr = vmAddr(depth, slot);
+      return true;
+    case ISAtom::TokType::INT:
+    case ISAtom::TokType::FLOAT:
+    case ISAtom::TokType::STRING:
+    case ISAtom::TokType::BOOLEAN:
+      addr = -1;
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  int vmEmitFused(vector<ISOp> &ops, ISOp::Code code, const ISAtom *pisa) {  // -1: not fusable
+    int addrL, addrR;
+    if (!isTwoOperands(pisa) || !vmFusedOperand(pisa, addrL) || !vmFusedOperand(pisa->pNext, addrR) || (addrL < 0 && addrR < 0)) return -1;
+    return (int)vmEmit(ops, code, pisa, addrL, addrR);
+  }
+
+  bool vmIncrement(const ISAtom *pisa, int &delta) {  // (set! x (+ x k)) or (set! x (- x k)), k an INT literal
+    const ISAtom *pVal = pisa->pNext;
+    if (pVal->t != ISAtom::TokType::LIST || !pVal->pChild || pVal->pChild->t != ISAtom::TokType::SYMBOL) return false;
+    const ISAtom *pHead = pVal->pChild;
+    if (pHead->vals != "+" && pHead->vals != "-") return false;
+    if (inbuilts[pHead->vals.symId()] == &IndraScheme::evalExtInbuilt || !isTwoOperands(pHead->pNext)) return false;
+    const ISAtom *pX = pHead->pNext, *pK = pX->pNext;
+    if (pX->t != ISAtom::TokType::SYMBOL || pX->vals.symId() != pisa->vals.symId() || pK->t != ISAtom::TokType::INT || pK->val == INT_MIN) return false;
+    delta = pHead->vals == "+" ? pK->val : -pK->val;
+    return true;
+  }
+
+  const ISAtom *vmFusedValue(int addr, const ISAtom *pLiteral, ISScopes &local_symbols) {  // nullptr: take the generic path
+    if (addr < 0) return pLiteral;
+    const ISAtom *p = vmSlot(addr, local_symbols);
+    if (p->t == ISAtom::TokType::SYMBOL || p->pNext) return nullptr;
+    return p;
+  }
+
+  static bool vmSingle(const ISAtom *p) {
+    return p && !p->pNext;
+  }
+
+  ISAtom *vmPop() {
+    ISAtom *p = vmStack.back();
+    vmStack.pop_back();
+    return p;
+  }
+
+  ISAtom *vmLink() {  // chain the values above the innermost mark, as chainEval() does
+    size_t mark = vmMarks.back();
+    vmMarks.pop_back();
+    if (vmStack.size() == mark) return gca();
+    ISAtom *pCE = vmStack[mark], *pCE_c = pCE;
+    for (size_t i = mark + 1; i < vmStack.size(); i++) {
+      pCE_c->pNext = vmStack[i];
+      pCE_c = pCE_c->pNext;
+    }
+    vmStack.resize(mark);
+    return pCE;
+  }
+
+  ISAtom *vmLocal(const ISOp &op, ISScopes &local_symbols) {  // lexically addressed local, as eval_symbol() returns it
+    ISAtom *p = local_symbols[local_symbols.size() - 1 - op.a].slot(op.b);
+    if (p->t == ISAtom::TokType::SYMBOL) return eval_symbol(op.p, local_symbols);
+    return shareList(p);
+  }
+
+  ISAtom *vmError(const string &msg) {
+    ISAtom *pRes = gca();
+    pRes->t = ISAtom::TokType::ERROR;
+    pRes->vals = msg;
+    return pRes;
+  }
+
+  // Type feedback: vmRun() records the parameter and result types of every call. A
+  // function called specThreshold times with single INT arguments only, that always
+  // returned INT or always BOOLEAN, is compiled to int code which runs on plain ints
+  // without allocating (a few attempts, callees may lack feedback at first). Calls
+  // with other arguments run the generic ops. A definition (defEpoch) drops the int
+  // code. If a run meets a case it doesn't cover (division by zero, no cond clause
+  // taken, a callee without int code), the call is evaluated generically from the
+  // start: the int code only covers pure bodies, so nothing gets done twice.
+  enum SpecType { SPEC_FAIL = -1,
+                  SPEC_INT,
+                  SPEC_BOOL,
+                  SPEC_VOID };  // value discarded
+  struct SpecLocal {
+    int id;
+    int reg;
+    int t;
+  };
+  bool intSpecialization = true;
+  int specThreshold = 16;
+  vector<int> specRegs;   // register windows of the running int code
+  vector<int> specStack;  // its operands
+  vector<vector<SpecLocal>> specScopes;
+  vector<const ISFunc *> specCompiling;
+  ISIntCode *pSpecCode = nullptr;
+
+  static unsigned specTypeBit(const ISAtom *p) {
+    return 1u << (p->pNext ? ISAtom::TokType::LIST : p->t);
+  }
+
+  ISAtom *specEnter(const ISFunc &code, ISFrame &frame) {  // nullptr: run the generic ops
+    if (!intSpecialization || frame.size() < (size_t)code.nParams) return nullptr;
+    for (int i = 0; i < code.nParams; i++) {
+      const ISAtom *p = frame.slot(i);
+      code.argTypes |= specTypeBit(p);
+      if (p->t != ISAtom::TokType::INT || p->pNext) return nullptr;
+    }
+    if (code.pIntCode && code.pIntCode->epoch != defEpoch) {
+      code.pIntCode.reset();
+      code.nCalls = code.nSpecAttempts = code.nDeopts = 0;
+    }
+    if (!code.pIntCode) {
+      if (code.nSpecAttempts >= 3 || ++code.nCalls < specThreshold << code.nSpecAttempts) return nullptr;
+      if (!specCompile(code)) return nullptr;
+    }
+    nativeArgs.resize(code.nParams);
+    for (int i = 0; i < code.nParams; i++)
+      nativeArgs[i] = frame.slot(i)->val;
+    size_t sp = specStack.size();
+    int v;
+    if (!specCall(code, nativeArgs.data(), v)) {
+      specStack.resize(sp);
+      if (++code.nDeopts >= specThreshold) {
+        code.pIntCode.reset();
+        code.nSpecAttempts = 3;
+      }
+      return nullptr;
+    }
+    return specBox(v, code.pIntCode->bBoolResult);
+  }
+
+  bool specCall(const ISFunc &fn, const int *args, int &res) {  // args must not point into specRegs
+    const ISIntCode *pIc = fn.pIntCode.get();
+    if (!pIc) return false;
+    if (pIc->pJit) return pIc->pJit(this, args, &res);
+    size_t base = specRegs.size();
+    specRegs.resize(base + pIc->nRegs);
+    std::copy(args, args + pIc->nParams, specRegs.begin() + base);
+    bool bDone = specRun(*pIc, base);
+    specRegs.resize(base);
+    if (bDone) res = specPop();
+    return bDone;
+  }
+
+  ISAtom *specBox(int v, bool bBool) {
+    if (bBool) return shareList(v ? pTrue : pFalse);
+    ISAtom *pRes = gca();
+    pRes->t = ISAtom::TokType::INT;
+    pRes->val = v;
+    return pRes;
+  }
+
+  int specPop() {
+    int v = specStack.back();
+    specStack.pop_back();
+    return v;
+  }
+
+  bool specRun(const ISIntCode &ic, size_t base) {  // false: not covered, else the result is on specStack
+    if (jitEnabled && ic.nRuns < jitThreshold && ++ic.nRuns == jitThreshold) jitCompile(ic);
+    const ISIntOp *ops = ic.ops.data();
+    int b;
+    for (size_t pc = 0;;) {
+      const ISIntOp &op = ops[pc++];
+      switch (op.op) {
+      case ISIntOp::CONST:
+        specStack.push_back(op.a);
+        break;
+      case ISIntOp::LOAD:
+        specStack.push_back(specRegs[base + op.a]);
+        break;
+      case ISIntOp::STORE:
+        specRegs[base + op.a] = specPop();
+        break;
+      case ISIntOp::ADD:
+        b = specPop();
+        specStack.back() += b;
+        break;
+      case ISIntOp::SUB:
+        b = specPop();
+        specStack.back() -= b;
+        break;
+      case ISIntOp::MUL:
+        b = specPop();
+        specStack.back() *= b;
+        break;
+      case ISIntOp::DIV:
+        b = specPop();
+        if (!b) return false;
+        specStack.back() /= b;
+        break;
+      case ISIntOp::MOD:
+        b = specPop();
+        if (!b) return false;
+        specStack.back() %= b;
+        break;
+      case ISIntOp::EQ:
+        b = specPop();
+        specStack.back() = specStack.back() == b;
+        break;
+      case ISIntOp::NE:
+        b = specPop();
+        specStack.back() = specStack.back() != b;
+        break;
+      case ISIntOp::GE:
+        b = specPop();
+        specStack.back() = specStack.back() >= b;
+        break;
+      case ISIntOp::LE:
+        b = specPop();
+        specStack.back() = specStack.back() <= b;
+        break;
+      case ISIntOp::LT:
+        b = specPop();
+        specStack.back() = specStack.back() < b;
+        break;
+      case ISIntOp::GT:
+        b = specPop();
+        specStack.back() = specStack.back() > b;
+        break;
+      case ISIntOp::AND:
+        b = specPop();
+        specStack.back() = specStack.back() && b;
+        break;
+      case ISIntOp::OR:
+        b = specPop();
+        specStack.back() = specStack.back() || b;
+        break;
+      case ISIntOp::JUMP:
+        pc = op.a;
+        break;
+      case ISIntOp::JUMP_FALSE:
+        if (!specPop()) pc = op.a;
+        break;
+      case ISIntOp::POP:
+        specStack.pop_back();
+        break;
+      case ISIntOp::CALL: {
+        const ISIntCode *pCallee = op.pFn->pIntCode.get();
+        if (!pCallee) return false;
+        if (pCallee->pJit) {
+          int v;
+          if (!pCallee->pJit(this, &specRegs[base + op.a], &v)) return false;  // native code copies the arguments first
+          specStack.push_back(v);
+          break;
+        }
+        size_t calleeBase = specRegs.size();
+        specRegs.resize(calleeBase + pCallee->nRegs);
+        for (int i = 0; i < op.b; i++)
+          specRegs[calleeBase + i] = specRegs[base + op.a + i];
+        bool bDone = specRun(*pCallee, calleeBase);
+        specRegs.resize(calleeBase);
+        if (!bDone) return false;
+      } break;
+      case ISIntOp::TAIL:
+        for (int i = 0; i < op.b; i++)
+          specRegs[base + i] = specRegs[base + op.a + i];
+        pc = 0;
+        break;
+      case ISIntOp::DEOPT:
+        return false;
+      case ISIntOp::RET:
+        return true;
+      }
+    }
+  }
+
+  // Operand stack depths of int code are static: the depth before each op (-1:
+  // unreachable) and which ops are jump targets. False if the code is inconsistent.
+  static bool specStackDepths(const ISIntCode &ic, vector<int> &depth, vector<bool> &target, int &maxDepth) {
+    size_t n = ic.ops.size();
+    depth.assign(n + 1, -1);
+    target.assign(n + 1, false);
+    depth[0] = 0;
+    maxDepth = 0;
+    auto reach = [&depth](size_t pc, int d) {
+      if (depth[pc] >= 0 && depth[pc] != d) return false;
+      depth[pc] = d;
+      return true;
+    };
+    for (size_t pc = 0; pc < n; pc++) {
+      const ISIntOp &op = ic.ops[pc];
+      int d = depth[pc];
+      if (d < 0) continue;
+      bool bNext = true;
+      switch (op.op) {
+      case ISIntOp::CONST:
+      case ISIntOp::LOAD:
+      case ISIntOp::CALL:
+        d++;
+        break;
+      case ISIntOp::JUMP:
+        target[op.a] = true;
+        if (!reach(op.a, d)) return false;
+        bNext = false;
+        break;
+      case ISIntOp::JUMP_FALSE:
+        d--;
+        target[op.a] = true;
+        if (!reach(op.a, d)) return false;
+        break;
+      case ISIntOp::TAIL:
+        target[0] = true;
+        bNext = false;
+        break;
+      case ISIntOp::DEOPT:
+      case ISIntOp::RET:
+        bNext = false;
+        break;
+      default:  // STORE, POP and the operators
+        d--;
+        break;
+      }
+      if (d < 0) return false;
+      if (d > maxDepth) maxDepth = d;
+      if (bNext && !reach(pc + 1, d)) return false;
+    }
+    return true;
+  }
+
+  // Second tier: int code that ran jitThreshold times is translated to x86-64, one
+  // template per op. Registers and operand stack slots are ints in the machine stack
+  // frame at static offsets from rbx. Self calls go straight to the entry, other calls
+  // through specCall(). The native code returns false where the int code would stop.
+  bool jitEnabled = true;
+  int jitThreshold = 64;
+
+  static bool jitCallThunk(IndraScheme *self, const ISFunc *pFn, const int *args, int *res) {
+    return self->specCall(*pFn, args, *res);
+  }
+
+#ifdef INSCH_JIT
+  void jitCompile(const ISIntCode &ic) {
+    vector<int> depth;
+    vector<bool> target;
+    int maxDepth;
+    if (!specStackDepths(ic, depth, target, maxDepth)) return;
+    vector<unsigned char> c;
+    auto emit = [&c](std::initializer_list<int> bytes) {
+      for (int b : bytes)
+        c.push_back((unsigned char)b);
+    };
+    auto imm32 = [&c](int v) {
+      for (int i = 0; i < 4; i++)
+        c.push_back((unsigned char)((unsigned)v >> (8 * i)));
+    };
+    auto imm64 = [&c](uint64_t v) {
+      for (int i = 0; i < 8; i++)
+        c.push_back((unsigned char)(v >> (8 * i)));
+    };
+    auto patch = [&c](size_t i, size_t to) {  // rel32 at i to code offset to
+      int rel = (int)to - (int)(i + 4);
+      for (int k = 0; k < 4; k++)
+        c[i + k] = (unsigned char)((unsigned)rel >> (8 * k));
+    };
+    auto rbx = [&](std::initializer_list<int> op, int disp) {  // op with a [rbx + disp32] operand
+      emit(op);
+      imm32(disp);
+    };
+    vector<size_t> at(ic.ops.size() + 1);
+    vector<std::pair<size_t, size_t>> jumps;  // rel32 to patch, target op
+    vector<size_t> deopts, exits;
+    auto jump = [&](std::initializer_list<int> op, vector<size_t> &patches) {
+      emit(op);
+      patches.push_back(c.size());
+      imm32(0);
+    };
+    int frame = (4 * (ic.nRegs + maxDepth) + 15) / 16 * 16 + 8;  // keeps rsp 16 byte aligned at calls
+    auto reg = [](int a) { return 4 * a; };
+    auto slot = [&ic](int d) { return 4 * (ic.nRegs + d); };
+
+    emit({0x55, 0x48, 0x89, 0xe5, 0x53, 0x41, 0x54, 0x41, 0x55});  // push rbp; mov rbp, rsp; push rbx, r12, r13
+    emit({0x48, 0x81, 0xec});                                      // sub rsp, frame
+    imm32(frame);
+    emit({0x49, 0x89, 0xfc, 0x49, 0x89, 0xd5, 0x48, 0x89, 0xe3});  // mov r12, rdi; mov r13, rdx; mov rbx, rsp
+    for (int i = 0; i < ic.nParams; i++) {
+      rbx({0x8b, 0x86}, reg(i));  // mov eax, [rsi + 4i]
+      rbx({0x89, 0x83}, reg(i));  // mov [rbx + 4i], eax
+    }
+    size_t body = c.size();
+    for (size_t pc = 0; pc < ic.ops.size(); pc++) {
+      const ISIntOp &op = ic.ops[pc];
+      int d = depth[pc];
+      at[pc] = c.size();
+      if (d < 0) continue;
+      switch (op.op) {
+      case ISIntOp::CONST:
+        rbx({0xc7, 0x83}, slot(d));
+        imm32(op.a);
+        break;
+      case ISIntOp::LOAD:
+        rbx({0x8b, 0x83}, reg(op.a));
+        rbx({0x89, 0x83}, slot(d));
+        break;
+      case ISIntOp::STORE:
+        rbx({0x8b, 0x83}, slot(d - 1));
+        rbx({0x89, 0x83}, reg(op.a));
+        break;
+      case ISIntOp::POP:
+        break;
+      case ISIntOp::ADD:
+      case ISIntOp::SUB:
+      case ISIntOp::MUL:
+      case ISIntOp::AND:
+      case ISIntOp::OR:
+        rbx({0x8b, 0x83}, slot(d - 2));
+        switch (op.op) {
+        case ISIntOp::ADD:
+          rbx({0x03, 0x83}, slot(d - 1));
+          break;
+        case ISIntOp::SUB:
+          rbx({0x2b, 0x83}, slot(d - 1));
+          break;
+        case ISIntOp::MUL:
+          rbx({0x0f, 0xaf, 0x83}, slot(d - 1));
+          break;
+        case ISIntOp::AND:
+          rbx({0x23, 0x83}, slot(d - 1));
+          break;
+        default:
+          rbx({0x0b, 0x83}, slot(d - 1));
+          break;
+        }
+        rbx({0x89, 0x83}, slot(d - 2));
+        break;
+      case ISIntOp::DIV:
+      case ISIntOp::MOD:
+        rbx({0x8b, 0x8b}, slot(d - 1));  // mov ecx, divisor
+        emit({0x85, 0xc9});               // test ecx, ecx
+        jump({0x0f, 0x84}, deopts);       // je deopt
+        rbx({0x8b, 0x83}, slot(d - 2));
+        emit({0x99, 0xf7, 0xf9});  // cdq; idiv ecx
+        rbx({0x89, op.op == ISIntOp::DIV ? 0x83 : 0x93}, slot(d - 2));
+        break;
+      case ISIntOp::EQ:
+      case ISIntOp::NE:
+      case ISIntOp::GE:
+      case ISIntOp::LE:
+      case ISIntOp::LT:
+      case ISIntOp::GT: {
+        static const int setcc[] = {0x94, 0x95, 0x9d, 0x9e, 0x9c, 0x9f};
+        rbx({0x8b, 0x83}, slot(d - 2));
+        rbx({0x3b, 0x83}, slot(d - 1));                                  // cmp eax, right
+        emit({0x0f, setcc[op.op - ISIntOp::EQ], 0xc0, 0x0f, 0xb6, 0xc0});  // setcc al; movzx eax, al
+        rbx({0x89, 0x83}, slot(d - 2));
+      } break;
+      case ISIntOp::JUMP:
+        emit({0xe9});
+        jumps.push_back({c.size(), (size_t)op.a});
+        imm32(0);
+        break;
+      case ISIntOp::JUMP_FALSE:
+        rbx({0x83, 0xbb}, slot(d - 1));  // cmp dword [rbx + disp], 0
+        emit({0x00, 0x0f, 0x84});
+        jumps.push_back({c.size(), (size_t)op.a});
+        imm32(0);
+        break;
+      case ISIntOp::CALL:
+        emit({0x4c, 0x89, 0xe7});  // mov rdi, r12
+        if (op.pFn->pIntCode.get() == &ic) {
+          rbx({0x48, 0x8d, 0xb3}, reg(op.a));  // lea rsi, args
+          rbx({0x48, 0x8d, 0x93}, slot(d));    // lea rdx, result
+          emit({0xe8});                        // call entry
+          imm32(-(int)(c.size() + 4));
+        } else {
+          emit({0x48, 0xbe});  // mov rsi, pFn
+          imm64((uint64_t)(uintptr_t)op.pFn);
+          rbx({0x48, 0x8d, 0x93}, reg(op.a));  // lea rdx, args
+          rbx({0x48, 0x8d, 0x8b}, slot(d));    // lea rcx, result
+          emit({0x48, 0xb8});                  // mov rax, jitCallThunk
+          imm64((uint64_t)(uintptr_t)&IndraScheme::jitCallThunk);
+          emit({0xff, 0xd0});  // call rax
+        }
+        emit({0x84, 0xc0});          // test al, al
+        jump({0x0f, 0x84}, deopts);  // je deopt
+        break;
+      case ISIntOp::TAIL:
+        for (int i = 0; i < op.b; i++) {
+          rbx({0x8b, 0x83}, reg(op.a + i));
+          rbx({0x89, 0x83}, reg(i));
+        }
+        emit({0xe9});
+        imm32((int)body - (int)(c.size() + 4));
+        break;
+      case ISIntOp::DEOPT:
+        jump({0xe9}, deopts);
+        break;
+      case ISIntOp::RET:
+        rbx({0x8b, 0x83}, slot(d - 1));
+        emit({0x41, 0x89, 0x45, 0x00, 0xb0, 0x01});  // mov [r13], eax; mov al, 1
+        jump({0xe9}, exits);
+        break;
+      }
+    }
+    at[ic.ops.size()] = c.size();
+    for (size_t i : deopts)
+      patch(i, c.size());
+    emit({0x31, 0xc0});  // deopt: xor eax, eax
+    for (size_t i : exits)
+      patch(i, c.size());
+    emit({0x48, 0x81, 0xc4});  // add rsp, frame
+    imm32(frame);
+    emit({0x41, 0x5d, 0x41, 0x5c, 0x5b, 0x5d, 0xc3});  // pop r13, r12, rbx, rbp; ret
+    for (auto &j : jumps)
+      patch(j.first, at[j.second]);
+
+    size_t size = (c.size() + 4095) & ~(size_t)4095;
+    void *pMem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pMem == MAP_FAILED) return;
+    std::copy(c.begin(), c.end(), (unsigned char *)pMem);
+    if (mprotect(pMem, size, PROT_READ | PROT_EXEC)) {
+      munmap(pMem, size);
+      return;
+    }
+    ic.pJitMem = pMem;
+    ic.jitSize = size;
+    ic.pJit = reinterpret_cast<ISJitFunc>(pMem);
+  }
+#else
+  void jitCompile(const ISIntCode &) {}  // int code keeps running interpreted
+#endif
+
+  // The compiler mirrors vmCompileInbuilt() for the forms it covers, on the same body.
+  // Every name must be a parameter or let variable of the body, typed INT or BOOLEAN
+  // statically; anything else fails and the function keeps its generic ops.
+  bool specCompile(const ISFunc &code) {
+    unsigned rt = code.resultTypes;
+    int t = rt == 1u << ISAtom::TokType::INT ? SPEC_INT : rt == 1u << ISAtom::TokType::BOOLEAN ? SPEC_BOOL : SPEC_FAIL;
+    if (t == SPEC_FAIL || (code.argTypes & ~(1u << ISAtom::TokType::INT)) || !specUniqueParams(code)) {
+      ++code.nSpecAttempts;
+      return false;
     }
-    ISAtom *pP = chainEval(pisa, local_symbols, true);
-    if (pP->t != ISAtom::TokType::STRING) {
-      pRes->t = ISAtom::TokType::ERROR;
-      pRes->vals = "'parse' requires a string to be parsed as parameter";
-      deleteList(pP, "evalParse 3");
-      return pRes;
+    std::unique_ptr<ISIntCode> pIc(new ISIntCode());
+    pIc->bBoolResult = t == SPEC_BOOL;
+    pIc->epoch = defEpoch;
+    pIc->nParams = pIc->nRegs = code.nParams;
+    vector<vector<SpecLocal>> outerScopes;
+    outerScopes.swap(specScopes);
+    ISIntCode *pOuterCode = pSpecCode;
+    pSpecCode = pIc.get();
+    specCompiling.push_back(&code);
+    specScopes.assign(1, {});
+    for (int i = 0; i < code.nParams; i++)
+      specScopes.back().push_back({code.paramIds[i], i, SPEC_INT});
+    bool bOk = specExpr(code.pBody, false, true) == t;
+    specEmit(ISIntOp::RET);
+    specCompiling.pop_back();
+    pSpecCode = pOuterCode;
+    specScopes.swap(outerScopes);
+    if (!bOk) {
+      ++code.nSpecAttempts;
+      return false;
     }
-    string cmd = pP->vals;
-    deleteList(pP, "EvalParse 0");
-    cmd += " ";
+    code.pIntCode = std::move(pIc);
+    return true;
+  }
 
-    if (cmd != "") {
-      int lvl = 0;
-      ISAtom *pisa_p = parse(cmd, nullptr, lvl);
-      ISAtom *pisa_res = chainEval(pisa_p, local_symbols, true);
-      deleteList(pisa_p, "evalParse 1");
-      deleteList(pRes, "evalParse 2");
-      return pisa_res;
-    } else {
-      pRes->t = ISAtom::TokType::NIL;
-      return pRes;
+  static bool specUniqueParams(const ISFunc &code) {
+    for (int i = 0; i < code.nParams; i++) {
+      for (int j = 0; j < i; j++)
+        if (code.paramIds[i] == code.paramIds[j]) return false;
     }
+    return true;
   }
 
-  ISAtom *load(string filename, vector<map<string, ISAtom *>> &local_symbols) {
-    char buf[129];
-    size_t nb;
-    string cmd = "";
-    ISAtom *pRes = gca();
-    FILE *fp = fopen(filename.c_str(), "r");
-    if (fp) {
-      while (!feof(fp)) {
-        nb = fread(buf, 1, 128, fp);
-        buf[nb] = 0;
-        cmd += buf;
+  size_t specEmit(ISIntOp::Code op, int a = 0, int b = 0, const ISFunc *pFn = nullptr) {
+    pSpecCode->ops.push_back({op, a, b, pFn});
+    return pSpecCode->ops.size() - 1;
+  }
+
+  int specValue(int t, bool bDiscard) {
+    if (!bDiscard) return t;
+    specEmit(ISIntOp::POP);
+    return SPEC_VOID;
+  }
+
+  bool specResolve(const ISAtom *p, SpecLocal &local) {
+    int id = p->vals.symId();
+    if (is_inbuilt(id) || is_defined_func(id)) return false;
+    for (size_t d = specScopes.size(); d-- > 0;) {
+      for (const SpecLocal &l : specScopes[d]) {
+        if (l.id != id) continue;
+        local = l;
+        return true;
       }
-      fclose(fp);
-    } else {
-      pRes->t = ISAtom::TokType::ERROR;
-      pRes->vals = "Could not read file: " + filename;
-      return pRes;
-    }
-    if (cmd != "") {
-      int lvl = 0;
-      ISAtom *pisa_p = parse(cmd, nullptr, lvl);
-      ISAtom *pisa_res = chainEval(pisa_p, local_symbols, false);
-      deleteList(pisa_p, "evalLoad 4");
-      deleteList(pRes, "evalLoad 5");
-      return pisa_res;
-    } else {
-      pRes->t = ISAtom::TokType::ERROR;
-      pRes->vals = "Empty file: " + filename;
-      return pRes;
     }
+    return false;
   }
 
-  ISAtom *evalLoad(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
-    ISAtom *pRes = gca();
-    ISAtom *pls = chainEval(pisa, local_symbols, true);
-    if (getListLen(pls) != 1) {
-      pRes->t = ISAtom::TokType::ERROR;
-      pRes->vals = "'load' requires one string operand, a filename, got: " + std::to_string(getListLen(pisa));
-      deleteList(pls, "load 1");
-      return pRes;
-    }
-    ISAtom *pP = (ISAtom *)pls;
-    if (pP->t != ISAtom::TokType::STRING) {
-      pRes->t = ISAtom::TokType::ERROR;
-      pRes->vals = "'load' requires a string operand, a filename";
-      deleteList(pls, "load 2");
-      return pRes;
+  int specExpr(const ISAtom *p, bool bDiscard, bool bTail) {  // bTail: the value is the function's result
+    SpecLocal local;
+    switch (p->t) {
+    case ISAtom::TokType::INT:
+      specEmit(ISIntOp::CONST, p->val);
+      return specValue(SPEC_INT, bDiscard);
+    case ISAtom::TokType::BOOLEAN:
+      specEmit(ISIntOp::CONST, p->val != 0);
+      return specValue(SPEC_BOOL, bDiscard);
+    case ISAtom::TokType::SYMBOL:
+      if (!specResolve(p, local)) return SPEC_FAIL;
+      specEmit(ISIntOp::LOAD, local.reg);
+      return specValue(local.t, bDiscard);
+    case ISAtom::TokType::LIST:
+      if (!p->pChild || p->pChild->t != ISAtom::TokType::SYMBOL) return SPEC_FAIL;
+      if (!is_inbuilt(p->pChild->vals.symId())) return specCall(p->pChild, bDiscard, bTail);
+      return specInbuilt(p->pChild, bDiscard, bTail);
+    default:
+      return SPEC_FAIL;
     }
-    ISAtom *pR = load(pP->vals, local_symbols);
-    deleteList(pls, "evalLoad 5.2");
-    deleteList(pRes, "evalLoad 5.3");
-    return pR;
   }
 
-  bool is_inbuilt(string funcName) {
-    if (inbuilts.find(funcName) == inbuilts.end()) return false;
-    return true;
+  int specBody(const ISAtom *pExpr, bool bDiscard, bool bTail) {  // a sequence, the last one gives the value
+    int t = SPEC_FAIL;
+    for (; pExpr && pExpr->t != ISAtom::TokType::NIL; pExpr = pExpr->pNext) {
+      bool bLast = !pExpr->pNext || pExpr->pNext->t == ISAtom::TokType::NIL;
+      t = bLast ? specExpr(pExpr, bDiscard, bTail) : specExpr(pExpr, true, false);
+      if (t == SPEC_FAIL) return SPEC_FAIL;
+    }
+    return t;
   }
 
-  ISAtom *eval_symbol(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
-    ISAtom *p, *pn, *pRet;
-    if (is_defined_symbol(pisa->vals, local_symbols)) {
-      if (is_defined_local_symbol(pisa->vals, local_symbols))
-        p = get_local_symbol(pisa->vals, local_symbols);
-      else if (symbols.find(pisa->vals) != symbols.end()) {
-        p = copyList(symbols[pisa->vals]);
-      } else {
-        pRet = gca();
-        pRet->t = ISAtom::TokType::ERROR;
-        pRet->vals = "Invalid state when resolving symbol: " + pisa->vals;
-        return pRet;
+  int specInbuilt(const ISAtom *pHead, bool bDiscard, bool bTail) {
+    const ISAtom *pisa = pHead->pNext;
+    if (!pisa || inbuilts[pHead->vals.symId()] == &IndraScheme::evalExtInbuilt) return SPEC_FAIL;
+    const string &name = pHead->vals;
+    size_t m_op;
+    if (name.length() == 1 && (m_op = string("+-*/%").find(name[0])) != string::npos) {
+      if (getListLen(pisa) < 2) return SPEC_FAIL;
+      for (const ISAtom *p = pisa; p && p->t != ISAtom::TokType::NIL; p = p->pNext) {
+        if (specExpr(p, false, false) != SPEC_INT) return SPEC_FAIL;
+        if (p != pisa) specEmit((ISIntOp::Code)(ISIntOp::ADD + m_op));
       }
-      string name = pisa->vals;
-      while (p->t == ISAtom::TokType::SYMBOL) {
-        if (is_defined_symbol(p->vals, local_symbols)) {
-          if (is_defined_local_symbol(p->vals, local_symbols)) {
-            pn = get_local_symbol(pisa->vals, local_symbols);
-          } else {
-            pn = copyList(symbols[p->vals]);
-          }
-          deleteList(p, "eval_symbol 2");
-          p = pn;
-          if (p->vals == name) {
-            break;
-          }
-        } else {
-          break;
+      return specValue(SPEC_INT, bDiscard);
+    }
+    for (int c_op = CMP_EQ; c_op <= CMP_OR; c_op++) {
+      if (name != cmp_op_name(c_op)) continue;
+      if (getListLen(pisa) != 2) return SPEC_FAIL;
+      int t = specExpr(pisa, false, false);
+      if (t == SPEC_FAIL || specExpr(pisa->pNext, false, false) != t) return SPEC_FAIL;
+      if (t == SPEC_INT ? c_op >= CMP_AND : (c_op != CMP_EQ && c_op != CMP_NE && c_op < CMP_AND)) return SPEC_FAIL;
+      specEmit((ISIntOp::Code)(ISIntOp::EQ + c_op));
+      return specValue(SPEC_BOOL, bDiscard);
+    }
+    if (name == "begin") return specBody(pisa, bDiscard, bTail);
+    if (name == "if") {
+      int n = getListLen(pisa);
+      if ((n != 2 && n != 3) || specExpr(pisa, false, false) != SPEC_BOOL) return SPEC_FAIL;
+      size_t iTest = specEmit(ISIntOp::JUMP_FALSE);
+      int t = specExpr(pisa->pNext, bDiscard, bTail);
+      size_t iJump = specEmit(ISIntOp::JUMP);
+      pSpecCode->ops[iTest].a = (int)pSpecCode->ops.size();
+      int tf = n == 3 ? specExpr(pisa->pNext->pNext, bDiscard, bTail) : bDiscard ? SPEC_VOID : SPEC_FAIL;
+      pSpecCode->ops[iJump].a = (int)pSpecCode->ops.size();
+      return t == tf ? t : SPEC_FAIL;
+    }
+    if (name == "cond") {
+      int n = getListLen(pisa), t = bDiscard ? SPEC_VOID : SPEC_FAIL;
+      vector<size_t> jumps;
+      for (int i = 0; i < n; i++) {
+        const ISAtom *ci = getListArgN(pisa, i);
+        if (ci->t != ISAtom::TokType::LIST || getListLen(ci->pChild) != 2) return SPEC_FAIL;
+        if (specExpr(ci->pChild, false, false) != SPEC_BOOL) return SPEC_FAIL;
+        size_t iTest = specEmit(ISIntOp::JUMP_FALSE);
+        int te = specExpr(ci->pChild->pNext, bDiscard, bTail);
+        if (te == SPEC_FAIL || (i && te != t)) return SPEC_FAIL;
+        t = te;
+        jumps.push_back(specEmit(ISIntOp::JUMP));
+        pSpecCode->ops[iTest].a = (int)pSpecCode->ops.size();
+      }
+      if (!bDiscard) specEmit(ISIntOp::DEOPT);
+      for (size_t i : jumps)
+        pSpecCode->ops[i].a = (int)pSpecCode->ops.size();
+      return n < 1 ? SPEC_FAIL : t;
+    }
+    if (name == "while") {
+      if (!bDiscard || getListLen(pisa) < 2) return SPEC_FAIL;
+      size_t iLoop = pSpecCode->ops.size();
+      if (specExpr(pisa, false, false) != SPEC_BOOL) return SPEC_FAIL;
+      size_t iTest = specEmit(ISIntOp::JUMP_FALSE);
+      for (const ISAtom *p = pisa->pNext; p && p->t != ISAtom::TokType::NIL; p = p->pNext) {
+        if (specExpr(p, true, false) == SPEC_FAIL) return SPEC_FAIL;
+      }
+      specEmit(ISIntOp::JUMP, (int)iLoop);
+      pSpecCode->ops[iTest].a = (int)pSpecCode->ops.size();
+      return SPEC_VOID;
+    }
+    if (name == "set!") {
+      SpecLocal local;
+      if (getListLen(pisa) != 2 || pisa->t != ISAtom::TokType::SYMBOL || !specResolve(pisa, local)) return SPEC_FAIL;
+      if (specExpr(pisa->pNext, false, false) != local.t) return SPEC_FAIL;
+      specEmit(ISIntOp::STORE, local.reg);
+      if (bDiscard) return SPEC_VOID;
+      specEmit(ISIntOp::LOAD, local.reg);
+      return local.t;
+    }
+    if (name == "let") {
+      if (pisa->t != ISAtom::TokType::LIST || !pisa->pNext || pisa->pNext->t == ISAtom::TokType::NIL) return SPEC_FAIL;
+      specScopes.push_back({});
+      for (const ISAtom *pDef = pisa->pChild; pDef && pDef->t != ISAtom::TokType::NIL; pDef = pDef->pNext) {
+        if (pDef->t != ISAtom::TokType::LIST || getListLen(pDef->pChild) != 2 || pDef->pChild->t != ISAtom::TokType::SYMBOL) return SPEC_FAIL;
+        int id = pDef->pChild->vals.symId();
+        int t = specExpr(pDef->pChild->pNext, false, false);
+        if (t == SPEC_FAIL) return SPEC_FAIL;
+        vector<SpecLocal> &scope = specScopes.back();
+        auto it = std::find_if(scope.begin(), scope.end(), [id](const SpecLocal &l) { return l.id == id; });
+        if (it == scope.end()) {
+          scope.push_back({id, pSpecCode->nRegs++, t});
+          it = scope.end() - 1;
+        } else if (it->t != t) {
+          return SPEC_FAIL;
         }
+        specEmit(ISIntOp::STORE, it->reg);
       }
-      return p;
-    } else {
-      pRet = gca();
-      pRet->t = ISAtom::TokType::ERROR;
-      pRet->vals = "Undefined symbol: " + pisa->vals;
-      return pRet;
+      int t = specBody(pisa->pNext, bDiscard, bTail);
+      specScopes.pop_back();
+      return t;
     }
+    return SPEC_FAIL;
   }
 
-  ISAtom *lambda_eval(const ISAtom *input_data, vector<map<string, ISAtom *>> &local_symbols, const ISAtom *pvars, const ISAtom *pfunc, int skipper = 0) {
-    ISAtom *p, *pn;
-    ISAtom *pRes = gca();
-    local_symbols.push_back({});
-    ISAtom *pNa = pvars->pChild;  // pDef->pChild;
-    vector<string> localNames;
-    int n = 0;
-    bool err = false;
+  int specCall(const ISAtom *pHead, bool bDiscard, bool bTail) {  // arguments bound as in vmCompileCall()
+    int id = pHead->vals.symId();
+    if (!is_defined_func(id)) return SPEC_FAIL;
+    const ISFunc *pCallee = funcInfo[id].get();
+    int argc = pHead->pNext ? getListLen(pHead->pNext) : 0;
+    if (argc != pCallee->nParams || !specUniqueParams(*pCallee)) return SPEC_FAIL;
+    if (!pCallee->pIntCode && std::find(specCompiling.begin(), specCompiling.end(), pCallee) == specCompiling.end()) {
+      if (pCallee->nSpecAttempts >= 3 || !specCompile(*pCallee)) return SPEC_FAIL;
+    }
+    unsigned rt = pCallee->resultTypes;
+    int t = rt == 1u << ISAtom::TokType::INT ? SPEC_INT : rt == 1u << ISAtom::TokType::BOOLEAN ? SPEC_BOOL : SPEC_FAIL;
+    if (t == SPEC_FAIL) return SPEC_FAIL;
+    int first = pSpecCode->nRegs;
+    pSpecCode->nRegs += argc;
+    specScopes.push_back({});
+    const ISAtom *pInp = pHead->pNext;
+    for (int i = 0; i < argc; i++, pInp = pInp->pNext) {
+      if (specExpr(pInp, false, false) != SPEC_INT) return SPEC_FAIL;
+      specEmit(ISIntOp::STORE, first + i);
+      specScopes.back().push_back({pCallee->paramIds[i], first + i, SPEC_INT});
+    }
+    specScopes.pop_back();
+    if (bTail && pCallee == specCompiling.back()) {
+      specEmit(ISIntOp::TAIL, first, argc);
+      return t;
+    }
+    specEmit(ISIntOp::CALL, first, argc, pCallee);
+    return specValue(t, bDiscard);
+  }
 
-    bool bDebugParams = false;
-    if (bDebugParams) {
-      cout << "InputData: ";
-      print(input_data, local_symbols, ISAtom::DecorType::UNICODE, true);
-      cout << endl;
-      cout << "pvars: ";
-      print(pvars, local_symbols, ISAtom::DecorType::UNICODE, true);
-      cout << endl;
-      cout << "pfunc: ";
-      print(pfunc, local_symbols, ISAtom::DecorType::UNICODE, true);
-      cout << endl;
-    }
-    while (pNa && !err) {
-      if (pNa->t == ISAtom::TokType::NIL) break;
-      if (pNa->t == ISAtom::TokType::SYMBOL) {
-        n = n + 1;
-        if (n > skipper) {
-          localNames.push_back(pNa->vals);
+  void vmTailFrames(ISScopes &local_symbols, size_t frameBase) {
+    // Tail call: the callee's frame on top replaces the finishing body's frames from
+    // frameBase up. Their bindings not shadowed by the callee are carried over behind
+    // its parameters, so dynamic lookups find the same values as with nested frames.
+    ISFrame &callee = local_symbols.back();
+    for (size_t i = local_symbols.size() - 1; i-- > frameBase;) {
+      for (auto &binding : local_symbols[i]) {
+        if (callee.find(binding.first) == callee.end()) {
+          callee[binding.first] = binding.second;
+        } else {
+          deleteList(binding.second, "tail call");
         }
-        pNa = pNa->pNext;
-      } else {
-        err = true;
-        pRes->t = ISAtom::TokType::ERROR;
-        pRes->vals = "'lambda' function requires symbols as operands, type " + tokTypeNames[pNa->t] + " is invalid, symbol required.";
-        pop_local_symbols(local_symbols);
-        return pRes;
-        break;
       }
+      local_symbols[i].clear();
     }
-    if (getListLen(input_data) != n - skipper) {
-      err = true;
-      pRes->t = ISAtom::TokType::ERROR;
-      pRes->vals = "Lambda requires " + std::to_string(n - skipper) + " arguments, " + std::to_string(getListLen(input_data)) + " given";
-      pop_local_symbols(local_symbols);
-      return pRes;
-    }
+    local_symbols[frameBase].swap(callee);
+    while (local_symbols.size() > frameBase + 1)
+      local_symbols.pop_back();
+  }
 
-    ISAtom *pCurVar;
-    const ISAtom *pInp = input_data;
-    for (auto var_name : localNames) {
-      bool bQuoted = false;
-      if (pInp->t == ISAtom::TokType::QUOTE) {
-        pInp = pInp->pNext;
-        bQuoted = true;
-      }
-      ISAtom *pS = copyAtom(pInp);
-      pS->pNext = gca();
-      bool bDoEval = true;
-      if (pS->t == ISAtom::TokType::STRING || pS->t == ISAtom::TokType::SYMBOL) {
-        string func_name = pS->vals;
-        if (is_inbuilt(func_name) || is_defined_func(func_name)) {
-          bDoEval = false;
+  ISAtom *vmRun(const ISFunc &code, ISScopes &local_symbols) {
+    EvalDepthGuard depthGuard(*this);
+    size_t frameBase = local_symbols.size() - 1;  // the frame holding this body's parameters
+    ISAtom *p = specEnter(code, local_symbols.back());
+    if (p) return p;
+    const ISFunc *pRunning = &code;  // whose ops run, changes with tail calls
+    const ISOp *ops = code.ops.data();
+    size_t nOps = code.ops.size();
+    for (size_t pc = 0; pc < nOps;) {
+      const ISOp &op = ops[pc++];
+      switch (op.op) {
+      case ISOp::CONST:
+        vmStack.push_back(copyAtom(op.p));
+        break;
+      case ISOp::SYM:
+        vmStack.push_back(gca(op.p));
+        break;
+      case ISOp::QUOTED:
+        vmStack.push_back(shareQuoted(op.p));
+        break;
+      case ISOp::QUOTE_ATOM:
+        vmStack.push_back(shareQuoted(op.p->pNext));
+        break;
+      case ISOp::LOAD:
+        vmStack.push_back(op.a >= 0 ? vmLocal(op, local_symbols) : eval_symbol(op.p, local_symbols));
+        break;
+      case ISOp::LOCAL:
+        if (is_defined_func(op.p->vals.symId())) {
+          vmStack.push_back(op.c ? eval(op.p, local_symbols) : evalAtom(op.p, local_symbols));
+        } else {
+          vmStack.push_back(vmLocal(op, local_symbols));
         }
+        break;
+      case ISOp::EVAL:
+        vmStack.push_back(eval(op.p, local_symbols));
+        break;
+      case ISOp::EVAL_ATOM:
+        vmStack.push_back(evalAtom(op.p, local_symbols));
+        break;
+      case ISOp::EVAL_FN:
+        vmStack.push_back(eval(op.p, local_symbols, true, op.a != 0));
+        break;
+      case ISOp::BUILTIN:
+        vmStack.push_back(call_inbuilt(op.a, op.p, local_symbols));
+        break;
+      case ISOp::MARK:
+        vmMarks.push_back(vmStack.size());
+        break;
+      case ISOp::BAIL:
+        p = vmStack.back();
+        if (p->t == ISAtom::TokType::ERROR || gcpool.overBudget) {
+          vmStack.pop_back();
+          if (p->t != ISAtom::TokType::ERROR) {
+            deleteList(p, "vm over budget");
+            p = heapError();
+          }
+          while (vmStack.size() > vmMarks.back())
+            deleteList(vmPop(), "vm bail");
+          vmStack.push_back(p);
+          pc = op.a;
+        } else {
+          vmStack.back() = ownHead(p);
+        }
+        break;
+      case ISOp::CHAIN:
+        vmStack.push_back(vmLink());
+        break;
+      case ISOp::MATH:
+        if (vmStack.size() == vmMarks.back() + 2 && vmSingle(vmStack.back()) && vmSingle(vmStack[vmStack.size() - 2]) && (p = math_fast(vmStack[vmStack.size() - 2], vmStack.back(), op.c))) {
+          deleteList(vmPop(), "vm math");
+          deleteList(vmPop(), "vm math");
+          vmMarks.pop_back();
+          vmStack.push_back(p);
+          break;
+        }
+        p = vmLink();
+        vmStack.push_back(math_kernel(p, op.c));
+        break;
+      case ISOp::CMP:
+        p = vmLink();
+        vmStack.push_back(cmp_kernel(p, op.c));
+        break;
+      case ISOp::MATH2:
+      case ISOp::CMP2: {
+        const ISAtom *pl = vmFusedValue(op.a, op.p, local_symbols);
+        const ISAtom *pr = vmFusedValue(op.b, op.p->pNext, local_symbols);
+        if (!pl || !pr || gcpool.overBudget) break;
+        int code = ops[op.c - 1].c;  // the MATH/CMP closing the generic ops
+        if (op.op == ISOp::CMP2) {
+          vmStack.push_back(cmp_result(pl, pr, code));
+        } else {
+          if (!(p = math_fast(pl, pr, code))) break;
+          vmStack.push_back(p);
+        }
+        pc = op.c;
+      } break;
+      case ISOp::ADD_LOCAL: {
+        ISAtom *&pSlot = vmSlot(op.a, local_symbols);
+        if (pSlot->t != ISAtom::TokType::INT || pSlot->pNext || gcpool.overBudget) break;
+        if (gcpool.refs(pSlot) == 1) {  // not shared: update in place
+          pSlot->val += op.b;
+        } else {
+          p = gca(pSlot);
+          p->val += op.b;
+          deleteList(pSlot, "Set! 1");
+          pSlot = p;
+        }
+        vmStack.push_back(shareList(pSlot));
+        pc = op.c;
+      } break;
+      case ISOp::JUMP:
+        pc = op.a;
+        break;
+      case ISOp::JUMP_IF_ERROR:
+        if (vmStack.back()->t == ISAtom::TokType::ERROR) pc = op.a;
+        break;
+      case ISOp::POP:
+        deleteList(vmPop(), "vm pop");
+        break;
+      case ISOp::NIL:
+        vmStack.push_back(gca());
+        break;
+      case ISOp::PUSH_NULL:
+        vmStack.push_back(nullptr);
+        break;
+      case ISOp::NULL_TO_NIL:
+        if (!vmStack.back()) vmStack.back() = gca();
+        break;
+      case ISOp::IF_TEST:
+      case ISOp::COND_TEST:
+      case ISOp::WHILE_TEST:
+        p = vmPop();
+        if (p->t != ISAtom::TokType::BOOLEAN) {
+          string msg;
+          if (op.op == ISOp::IF_TEST) {
+            msg = "'if' condition should result in boolean, but we got: " + tokTypeNames[p->t];
+          } else if (op.op == ISOp::COND_TEST) {
+            msg = "'cond' first operands must eval to boolean, index " + std::to_string(op.c) + " invalid";
+          } else {
+            msg = "'while' condition should result in boolean, but we got: " + tokTypeNames[p->t];
+            if (vmStack.back()) deleteList(vmStack.back(), "vm while");
+            vmStack.pop_back();
+          }
+          deleteList(p, "vm test");
+          vmStack.push_back(vmError(msg));
+          pc = op.b;
+        } else {
+          bool bVal = p->val;
+          deleteList(p, "vm test");
+          if (!bVal) {
+            pc = op.a;
+          } else if (op.op == ISOp::WHILE_TEST) {
+            if (vmStack.back()) deleteList(vmStack.back(), "vm while");
+            vmStack.pop_back();
+          }
+        }
+        break;
+      case ISOp::BUDGET:
+        if (gcpool.overBudget) {
+          deleteList(vmPop(), "vm over budget");
+          vmStack.push_back(heapError());
+          pc = op.a;
+        }
+        break;
+      case ISOp::SET_CHECK:
+        if (!is_defined_local_symbol(op.a, local_symbols)) {
+          vmStack.push_back(vmError("'set!' requires existing local var name as first param"));
+          pc = op.b;
+        }
+        break;
+      case ISOp::SET:
+        p = vmStack.back();
+        for (int in = (int)local_symbols.size() - 1; in >= 0; in--) {
+          auto pos = local_symbols[in].find(op.a);
+          if (pos != local_symbols[in].end()) {
+            deleteList(pos->second, "Set! 1");
+            pos->second = shareList(p);
+            p = nullptr;
+            break;
+          }
+        }
+        if (p) {
+          deleteList(vmPop(), "Set! 2");
+          vmStack.push_back(vmError("'set!' requires existing local var name as first param, couldn't find variable, internal error!"));
+        }
+        break;
+      case ISOp::SET_LOCAL: {
+        ISAtom *&pSlot = local_symbols[local_symbols.size() - 1 - op.a].slot(op.b);
+        deleteList(pSlot, "Set! 1");
+        pSlot = shareList(vmStack.back());
+      } break;
+      case ISOp::SCOPE_PUSH:
+        local_symbols.push_back({});
+        break;
+      case ISOp::SCOPE_POP:
+        pop_local_symbols(local_symbols);
+        break;
+      case ISOp::COPYLIST:
+        p = vmStack.back();
+        vmStack.back() = copyList(p);
+        deleteList(p, "makeLocalDefine 4");
+        break;
+      case ISOp::COPY_NIL:
+        p = copyAtom(op.p);
+        p->pNext = gca();
+        vmStack.push_back(p);
+        break;
+      case ISOp::BIND:
+        set_local_symbol(op.a, vmPop(), local_symbols);
+        break;
+      case ISOp::ARG_NAME: {
+        int id = op.p->vals.findSymId();
+        if (is_inbuilt(id) || is_defined_func(id)) {
+          p = copyAtom(op.p);
+          p->pNext = gca();
+        } else if (op.a >= 0) {
+          p = vmLocal(op, local_symbols);
+        } else {
+          p = evalAtom(op.p, local_symbols);
+        }
+        vmStack.push_back(p);
+      } break;
+      case ISOp::CALL: {
+        // Guard: a user function of matching arity, else the generic eval() path
+        if (op.cacheEpoch != defEpoch) {
+          int id = op.p->vals.symId();
+          const ISFunc *pCode = is_defined_func(id) ? funcInfo[id].get() : nullptr;
+          if (pCode && (pCode->nParams != op.a || (op.c && pCode->serial != op.c))) pCode = nullptr;
+          op.pCached = pCode;
+          op.cacheEpoch = defEpoch;
+        }
+        if (!op.pCached) {
+          vmStack.push_back(eval(op.p, local_symbols, true));
+          pc = op.b;
+          break;
+        }
+        local_symbols.push_back({});
+        vmCalls.push_back(op.pCached);
+      } break;
+      case ISOp::CALL_LAMBDA:
+        local_symbols.push_back({});
+        vmCalls.push_back(op.pCached);
+        break;
+      case ISOp::CLOSURE:
+        vmStack.push_back(makeClosure(op.p, *op.pCached, local_symbols, true));
+        break;
+      case ISOp::BIND_PARAM:
+        set_local_symbol(vmCalls.back()->paramIds[op.a], vmPop(), local_symbols);
+        break;
+      case ISOp::INVOKE: {
+        const ISFunc *pCode = vmCalls.back();
+        vmCalls.pop_back();
+        if (op.c) {  // tail call: continue with the callee's body in this frame
+          vmTailFrames(local_symbols, frameBase);
+          pRunning = pCode;
+          p = specEnter(*pCode, local_symbols.back());
+          if (p) {
+            vmStack.push_back(p);
+            pc = nOps;
+            break;
+          }
+          ops = pCode->ops.data();
+          nOps = pCode->ops.size();
+          pc = 0;
+          break;
+        }
+        p = vmRun(*pCode, local_symbols);
+        pop_local_symbols(local_symbols);
+        vmStack.push_back(p);
+      } break;
       }
-      if (bQuoted) {
-        bDoEval = false;
-      }
-      ISAtom *pT;
-      if (bDoEval)
-        pT = eval(pS, local_symbols);
-      else
-        pT = copyList(pS);
-
-      set_local_symbol(var_name, pT, local_symbols);
-      deleteList(pS, "LAM-DELSYM");
-      pInp = pInp->pNext;
     }
-    p = eval(pfunc, local_symbols);
-    pop_local_symbols(local_symbols);
-    deleteList(pRes, "lambda 1");
+    p = vmPop();
+    code.resultTypes |= specTypeBit(p);
+    pRunning->resultTypes |= specTypeBit(p);
     return p;
   }
 
-  ISAtom *eval_func(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols) {
-    ISAtom *pRes = gca();
-    string fun_name = pisa->vals;
-    if (is_defined_func(fun_name)) {
-      ISAtom *pDef = funcs[fun_name];
-      ISAtom *pvars = copyAtom(pDef);
-      ISAtom *pfunc = pDef->pNext;
-      ISAtom *p = lambda_eval(pisa->pNext, local_symbols, pvars, pfunc, 1);
-      deleteList(pRes, "ev_func 1");
-      deleteList(pvars, "ev_func 2");
-      return p;
-    } else {
-      pRes->t = ISAtom::TokType::ERROR;
-      pRes->vals = "Undefined function >" + pisa->vals + "< Internal error.";
-      return pRes;
-    }
-  }
-
-  ISAtom *eval(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols, bool func_only = false, bool bNested = false) {
+  ISAtom *eval(const ISAtom *pisa, ISScopes &local_symbols, bool func_only = false, bool bNested = false) {
     ISAtom *pN, *pRet = nullptr;  //, *pReti;
+    int id;
 
     ISAtom *p = (ISAtom *)pisa;
     pN = p->pNext;
+    EvalDepthGuard depthGuard(*this);
 
     bool bShowEval = false;
     if (bShowEval) {
@@ -2980,11 +6189,19 @@ class IndraScheme {
 
     switch (p->t) {
     case ISAtom::TokType::QUOTE:
-      pRet = copyList(pN);
+      if (pN) {
+        pRet = shareQuoted(pN);
+        pRet->pNext = copyList(pN->pNext);
+      }
       return pRet;
       break;
     case ISAtom::TokType::LIST:
       if (pisa->pChild->vals == "lambda") {
+        // Without arguments the lambda is a value, unless it's in call position: ((lambda () ...))
+        int arity = lambdaArity(pisa->pChild->pNext);
+        if ((!pisa->pNext || pisa->pNext->t == ISAtom::TokType::NIL) && (arity > 0 || (arity == 0 && !func_only))) {
+          return makeLambda(pisa->pChild->pNext, local_symbols);
+        }
         ISAtom *pvars = copyAtom(pisa->pChild->pNext);
         pRet = lambda_eval(pisa->pNext, local_symbols, pvars, pisa->pChild->pNext->pNext);
         deleteList(pvars, "LIST-LAMBDA");
@@ -3020,6 +6237,7 @@ class IndraScheme {
             pRet = eval(pEv, local_symbols, true);
           }
           if (!pRet->pNext) {
+            pRet = ownHead(pRet);
             pRet->pNext = copyList(pisa->pNext);
             ISAtom *pRetT = eval(pRet, local_symbols, true);
             deleteList(pRet, "Indirect eval intermediate");
@@ -3029,6 +6247,11 @@ class IndraScheme {
           }
         } else {
           pRet = eval(pisa->pChild, local_symbols, true);
+          if (func_only && pRet && pRet->t == ISAtom::TokType::CLOSURE && pisa->pNext && pisa->pNext->t != ISAtom::TokType::NIL) {
+            ISAtom *pF = pRet;  // ((expr) args) where expr returned a closure
+            pRet = closureApply(pF, pisa->pNext, local_symbols);
+            deleteList(pF, "Closure call");
+          }
         }
         if (!pRet) {
           cout << "EVAL returned nulltpr! ";
@@ -3046,27 +6269,35 @@ class IndraScheme {
       return pRet;
       break;
     case ISAtom::TokType::SYMBOL:
-      if (is_inbuilt(pisa->vals)) {
-        pRet = inbuilts[pisa->vals](pisa->pNext, local_symbols);
-      } else if (is_defined_func(pisa->vals)) {
+      id = pisa->vals.symId();
+      if (is_inbuilt(id)) {
+        pRet = call_inbuilt(id, pisa->pNext, local_symbols);
+      } else if (is_defined_func(id)) {
         pRet = eval_func(pisa, local_symbols);
-      } else if (!func_only && is_defined_symbol(pisa->vals, local_symbols)) {
+      } else if (!func_only && is_defined_symbol(id, local_symbols)) {
         pRet = eval_symbol(pisa, local_symbols);
       } else {
         if (func_only) {
           ISAtom *pS = gca(pisa);  // copyAtom?
           ISAtom *pResolve = eval_symbol(pS, local_symbols);
+          if (pResolve->t == ISAtom::TokType::CLOSURE) {
+            pRet = closureApply(pResolve, pisa->pNext, local_symbols);
+            deleteList(pResolve, "Sym2Func closure");
+            deleteList(pS, "Sym2Func closure 1");
+            return pRet;
+          }
           if (pResolve->t == ISAtom::TokType::STRING || pResolve->t == ISAtom::TokType::SYMBOL) {
             string func_name = pResolve->vals;
+            id = pResolve->vals.findSymId();  // a name never interned is no function
             deleteList(pResolve, "Sym2Func resolver 1");
             deleteList(pS, "Sym2Func resolver 1.1");
             ISAtom *pCpisa = copyList(pisa);
-            pCpisa->vals = func_name;
-            if (is_inbuilt(pCpisa->vals)) {
-              pRet = inbuilts[pCpisa->vals](pCpisa->pNext, local_symbols);
+            if (id >= 0) pCpisa->vals = ISStr::intern(func_name);
+            if (is_inbuilt(id)) {
+              pRet = call_inbuilt(id, pCpisa->pNext, local_symbols);
               deleteList(pCpisa, "Sym2Func resolver 2");
               return pRet;
-            } else if (is_defined_func(pCpisa->vals)) {
+            } else if (is_defined_func(id)) {
               pRet = eval_func(pCpisa, local_symbols);
               deleteList(pCpisa, "Sym2Func resolver 3");
               return pRet;
@@ -3088,6 +6319,10 @@ class IndraScheme {
       pRet = copyList(p);
       return pRet;
       break;
+    case ISAtom::TokType::CLOSURE:
+      if (func_only) return closureApply(p, pN, local_symbols);
+      return copyAtom(p);
+      break;
     default:
       if (func_only) {
         pRet = gca();
@@ -3102,102 +6337,99 @@ class IndraScheme {
     }
   }
 
-  ISAtom *chainEval(const ISAtom *pisa, vector<map<string, ISAtom *>> &local_symbols, bool bChainResult) {
-    size_t start_index = gc_size();
-
-    ISAtom *p = (ISAtom *)pisa, *pi, *pn;
+  ISAtom *chainEval(const ISAtom *pisa, ISScopes &local_symbols, bool bChainResult) {
+    const ISAtom *p = pisa;
     ISAtom *pCE = nullptr, *pCEi, *pCE_c = nullptr;
     bool is_quote = false;
     bool bShowEval = false;
 
-    vector<ISAtom *> pAllocs;
+    EvalDepthGuard depthGuard(*this);
     while (p) {
       if (p->t == ISAtom::TokType::NIL) {
         break;
       }
-      pn = p->pNext;
-      p->pNext = nullptr;
-
-      pi = copyAtom(p);
-      pAllocs.push_back(pi);
+      if (gcpool.overBudget) {
+        if (pCE) deleteList(pCE, "chainEval over budget");
+        pCE = heapError();
+        break;
+      }
+      if (gcTracing && evalDepth == 1 && gcpool.nAllocs - gcLastAllocs > gcThreshold) {
+        gc_protect(pisa);
+        gc_protect(pCE);
+        gc_collect(local_symbols);
+        gc_unprotect(2);
+      }
 
-      switch (pi->t) {
+      // Elements are evaluated in place, eval() doesn't modify its input.
+      switch (p->t) {
       case ISAtom::TokType::QUOTE:
         if (is_quote) {
-          pCEi = copyList(pi);
-          pAllocs.push_back(pCEi);
+          pCEi = gca(p);
+          pCEi->pNext = gca();
           is_quote = false;
         } else {
-          pCEi = nullptr;  // copyList(p->pNext);  // nullptr;
+          pCEi = nullptr;
           is_quote = true;
         }
         break;
       case ISAtom::TokType::SYMBOL:
         if (is_quote) {
-          pCEi = copyList(pi);
+          pCEi = gca(p);
           is_quote = false;
         } else {
-          pCEi = eval_symbol(pi, local_symbols);
+          pCEi = eval_symbol(p, local_symbols);
         }
-        pAllocs.push_back(pCEi);
         break;
       case ISAtom::TokType::LIST:
         if (is_quote) {
-          pCEi = copyList(pi);
+          pCEi = shareQuoted(p);
           is_quote = false;
         } else {
-          if (pi->pChild->pChild) {
+          if (p->pChild->pChild) {
             if (bShowEval) {
               cout << "INDIRECT! ";
-              print(pi->pChild, local_symbols, ISAtom::DecorType::UNICODE, true);
+              print(p->pChild, local_symbols, ISAtom::DecorType::UNICODE, true);
               cout << endl;
             }
-            pCEi = eval(pi->pChild, local_symbols, true, true);
+            pCEi = eval(p->pChild, local_symbols, true, true);
             if (bShowEval) {
               cout << "IND_RESU: ";
               print(pCEi, local_symbols, ISAtom::DecorType::UNICODE, true);
               cout << endl;
             }
           } else {
-            pCEi = eval(pi->pChild, local_symbols, true);
+            pCEi = eval(p->pChild, local_symbols, true);
           }
         }
-        pAllocs.push_back(pCEi);
         break;
       default:
         is_quote = false;
-        pCEi = copyAtom(pi);
-        pAllocs.push_back(pCEi);
+        pCEi = copyAtom(p);
         break;
       }
-      p->pNext = pn;
-      p = pn;
+      p = p->pNext;
       if (pCEi) {
+        // pCEi is an owned reference (possibly shared with a variable): link it without copying
         if (pCEi->t == ISAtom::TokType::ERROR) {
           if (pCE) deleteList(pCE, "Error on EvalChain");
-          pCE = copyList(pCEi);
+          pCE = pCEi;
           break;
         }
 
         if (!bChainResult) {
           if (pCE) deleteList(pCE, "chainEval not chain1");
-          pCE = copyList(pCEi);
+          pCE = pCEi;
         } else {
           if (!pCE) {
-            pCE_c = copyList(pCEi);
+            pCE_c = ownHead(pCEi);
             pCE = pCE_c;
           } else {
-            pCE_c->pNext = copyList(pCEi);
+            pCE_c->pNext = ownHead(pCEi);
             pCE_c = pCE_c->pNext;
           }
         }
       }
     }
-    int n = 0;
-    for (auto p : pAllocs) {
-      deleteList(p, "chainEval 4-" + std::to_string(n));
-      ++n;
-    }
     if (!pCE) pCE = gca();
     return pCE;
   }
@@ -41,6 +41,21 @@
 (define err_count 0)
 (define ok_count 0)
 
+; Tracing collection after every top-level expression from here on (repl inbuilt)
+(gctracing #t)
+(define gc_keep (range 1000))
+(define gc_junk (map * gc_keep gc_keep))
+(if (and (== (length gc_keep) 1000) (== (index gc_junk 999) 998001))
+    (begin
+        (print "Tracing GC OK\n")
+        (define ok_count (+ ok_count 1))
+    )
+    (begin
+        (print "Tracing GC ERROR\n")
+        (define err_count (+ err_count 1))
+    )
+)
+
 ; There are 25 primes in [2..100]:
 (if (== (length (primes 100)) 25) 
     (begin
@@ -361,6 +376,223 @@
     )
 )
 
+; Tail calls reuse the caller's frame, 100000 deep in constant stack
+(define (count_down n acc) (if (== n 0) acc (count_down (- n 1) (+ acc 1))))
+(define (is_even n) (if (== n 0) #t (is_odd (- n 1))))
+(define (is_odd n) (if (== n 0) #f (is_even (- n 1))))
+(if (and (== (count_down 100000 0) 100000) (== (is_even 100001) #f))
+    (begin
+        (print "Deep tail calls OK\n")
+        (define ok_count (+ ok_count 1))
+    )
+    (begin
+        (print "Deep tail calls ERROR\n")
+        (define err_count (+ err_count 1))
+    )
+)
+
+; Constant folding: folded calls and dropped branches give what the same calls on runtime values give
+(define (secs_per_day) (* 24 60 60))
+(define (secs_per n) (* n 60 60))
+(define (shout) (uppercase "abc"))
+(define (shout_s s) (uppercase s))
+(define (dead_branch x) (if (< 1 2) (+ x 1) (undefined_function x)))
+(define (live_branch x y) (if (< y 2) (+ x 1) (undefined_function x)))
+(if (and (and (== (secs_per_day) (secs_per 24)) (== (shout) (shout_s "abc")))
+         (== (dead_branch 1) (live_branch 1 1)))
+    (begin
+        (print "Constant folding OK\n")
+        (define ok_count (+ ok_count 1))
+    )
+    (begin
+        (print "Constant folding ERROR\n")
+        (define err_count (+ err_count 1))
+    )
+)
+
+; Fused counting-loop instructions on locals
+(define (count_multiples n d) (let ((i 1) (c 0)) (while (<= i n) (if (== (% i d) 0) (set! c (+ c 1))) (set! i (+ i 1))) c))
+(define (sum_down n) (let ((s 0)) (while (> n 0) (set! s (+ s n)) (set! n (- n 1))) s))
+(if (and (== (count_multiples 1000 7) 142) (== (sum_down 1000) 500500))
+    (begin
+        (print "Fused loops OK\n")
+        (define ok_count (+ ok_count 1))
+    )
+    (begin
+        (print "Fused loops ERROR\n")
+        (define err_count (+ err_count 1))
+    )
+)
+
+; Int code: hot INT functions, division by zero falls back to the generic code, redefinition replaces them
+(define (int_rem a b) (% a b))
+(define (int_rem_plus a b) (+ (int_rem a b) 1))
+(define (int_rem_sum n d) (let ((i 1) (s 0)) (while (<= i n) (set! s (+ s (int_rem_plus i d))) (set! i (+ i 1))) s))
+(define int_rem_hot (int_rem_sum 30 7))
+(if (and (== int_rem_hot 117) (and (== (type (int_rem 1 0)) 'Error) (== (type (int_rem_plus 1 0)) 'Error)))
+    (begin
+        (print "Int code division by zero OK\n")
+        (define ok_count (+ ok_count 1))
+    )
+    (begin
+        (print "Int code division by zero ERROR\n")
+        (define err_count (+ err_count 1))
+    )
+)
+
+(define (int_rem a b) (* a b))
+(if (and (== (int_rem 6 3) 18) (and (== (int_rem_plus 6 3) 19) (== (int_rem_sum 3 2) 15)))
+    (begin
+        (print "Int code redefinition OK\n")
+        (define ok_count (+ ok_count 1))
+    )
+    (begin
+        (print "Int code redefinition ERROR\n")
+        (define err_count (+ err_count 1))
+    )
+)
+
+; Native code: the same for int code that ran often enough to be compiled to machine code
+(define (jit_quot a b) (/ a b))
+(define (jit_quot_plus a b) (+ (jit_quot a b) 1))
+(define (jit_quot_sum n) (let ((i 1) (s 0)) (while (<= i n) (set! s (+ s (jit_quot_plus 1000 i))) (set! i (+ i 1))) s))
+(define jit_quot_hot (jit_quot_sum 300))
+(if (and (== jit_quot_hot 6436) (and (== (type (jit_quot 1 0)) 'Error) (== (type (jit_quot_plus 1 0)) 'Error)))
+    (begin
+        (print "Native code division by zero OK\n")
+        (define ok_count (+ ok_count 1))
+    )
+    (begin
+        (print "Native code division by zero ERROR\n")
+        (define err_count (+ err_count 1))
+    )
+)
+
+(define (jit_quot a b) (* a b))
+(if (and (== (jit_quot 6 3) 18) (and (== (jit_quot_plus 6 3) 19) (== (jit_quot_sum 3) 6003)))
+    (begin
+        (print "Native code redefinition OK\n")
+        (define ok_count (+ ok_count 1))
+    )
+    (begin
+        (print "Native code redefinition ERROR\n")
+        (define err_count (+ err_count 1))
+    )
+)
+
+; Escape analysis: let bindings that can't outlive the let share the value, others get a private copy
+(define shared_list '(1 2 3))
+(define (let_local n) (let ((l (range n))) (length l)))
+(define (let_shared_local) (let ((l shared_list)) (length l)))
+(define (let_escapes x) (let ((l shared_list)) (begin (set! l (append l x)) l)))
+(define escaped_4 (let_escapes 4))
+(define escaped_5 (let_escapes 5))
+(if (and (and (== (let_local 10) 10) (== (let_shared_local) 3))
+         (and (and (== (length shared_list) 3) (== (index escaped_4 3) 4)) (== (index escaped_5 3) 5)))
+    (begin
+        (print "Let escape analysis OK\n")
+        (define ok_count (+ ok_count 1))
+    )
+    (begin
+        (print "Let escape analysis ERROR\n")
+        (define err_count (+ err_count 1))
+    )
+)
+
+; Closures: captured locals, stored and returned lambdas, map and every
+(define (make_adder n) (lambda (x) (+ x n)))
+(define add5 (make_adder 5))
+(define (apply_twice f x) (f (f x)))
+(if (and (== ((make_adder 1) 1) 2) (and (== (add5 3) 8) (== (apply_twice add5 1) 11)))
+    (begin
+        (print "Closure capture OK\n")
+        (define ok_count (+ ok_count 1))
+    )
+    (begin
+        (print "Closure capture ERROR\n")
+        (define err_count (+ err_count 1))
+    )
+)
+
+(define (scale_all l k) (map (lambda (x) (* x k)) l))
+(let ((sum 0) (add3 (make_adder 3)))
+    (every (lambda (x) (set! sum (+ sum x))) (map add3 (scale_all '(1 2 3) 10)))
+    (if (== sum 69)
+        (begin
+            (print "Closure map/every OK\n")
+            (define ok_count (+ ok_count 1))
+        )
+        (begin
+            (print "Closure map/every failed: sum=" sum "\n")
+            (define err_count (+ err_count 1))
+        )
+    )
+)
+
+(define (make_adder n) (lambda (x) (- x n)))
+(if (and (== ((make_adder 1) 1) 0) (== (add5 3) 8))
+    (begin
+        (print "Closure after redefinition OK\n")
+        (define ok_count (+ ok_count 1))
+    )
+    (begin
+        (print "Closure after redefinition ERROR\n")
+        (define err_count (+ err_count 1))
+    )
+)
+
+(define (make_thunk n) (lambda () (* n 2)))
+(define thunk7 (make_thunk 7))
+(define (call_thunk f) (f))
+(if (and (== (thunk7) 14) (and (== (call_thunk (make_thunk 3)) 6) (== ((lambda () 9)) 9)))
+    (begin
+        (print "Closure without arguments OK\n")
+        (define ok_count (+ ok_count 1))
+    )
+    (begin
+        (print "Closure without arguments ERROR\n")
+        (define err_count (+ err_count 1))
+    )
+)
+
+(define (sum_scaled n k) (let ((sum 0)) (begin (while (> n 0) (every (lambda (x) (set! sum (+ sum x))) (scale_all '(1 2 3) k)) (set! n (- n 1))) sum)))
+(if (and (== (sum_scaled 100 2) 1200) (== (sum_scaled 10 3) 180))
+    (begin
+        (print "Closure map/every repeated OK\n")
+        (define ok_count (+ ok_count 1))
+    )
+    (begin
+        (print "Closure map/every repeated ERROR\n")
+        (define err_count (+ err_count 1))
+    )
+)
+
+; Heap budget (repl inbuilt), atoms and string buffers are counted
+(define (double_string s n) (begin (while (> n 0) (set! s (+ s s)) (set! n (- n 1))) s))
+(if (and (== (type (heapbudget 100000 (range 100000))) 'Error)
+         (and (== (type (heapbudget 100000 (double_string "budget" 20))) 'Error)
+              (== (length (heapbudget 100000 (range 100))) 100)))
+    (begin
+        (print "Heap budget OK\n")
+        (define ok_count (+ ok_count 1))
+    )
+    (begin
+        (print "Heap budget ERROR\n")
+        (define err_count (+ err_count 1))
+    )
+)
+(define budget_err (type (heapbudget 100000 (range 100000))))
+(if (and (== budget_err 'Error) (== (length (range 100000)) 100000))
+    (begin
+        (print "Heap budget recovery OK\n")
+        (define ok_count (+ ok_count 1))
+    )
+    (begin
+        (print "Heap budget recovery ERROR\n")
+        (define err_count (+ err_count 1))
+    )
+)
+
 (print "--------------------------------------------\n")
 (print " Test OK:  " ok_count "\n")
 (print " Test ERR: " err_count "\n")